@@ -1,7 +1,11 @@
 #ifndef ANY_H
 #define ANY_H
 #include <algorithm>
-#include <memory>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "memory_resource.h"
 
 class BadAnyCast : public std::exception {
     public:
@@ -10,108 +14,376 @@ class BadAnyCast : public std::exception {
 	}
 };
 
+// Type-specific operations on the storage of an Any. Each stored type has one
+// stateless Derived instance; storage holds either the value itself (Inline)
+// or a pointer to a HeapValue, which remembers the resource it was allocated
+// from. The address of that instance
+// identifies the stored type, so casts are a pointer compare and work without
+// RTTI.
 class Base {
 public:
-	virtual std::unique_ptr<Base> Clone() const = 0;
+	virtual void Copy(const void* from, void* to) const = 0;
+	virtual void Move(void* from, void* to) const noexcept = 0;
+	virtual void Destroy(void* storage) const noexcept = 0;
 	virtual ~Base() = default;
 };
 
 template<class T>
-class Derived : public Base {
+struct HeapValue {
 	T value_;
+	MemoryResource* resource_;
+
+	template<class... Args>
+	explicit HeapValue(MemoryResource* resource, Args&&... args);
+};
 
+template<class T, bool Inline>
+class Derived : public Base {
 public:
-	Derived() = default;
-	Derived(const T& other);
-	Derived(T&& other);
-	std::unique_ptr<Base> Clone() const override;
-	T Get() const;
+	static const Derived kInstance;
+
+	static T* Get(void* storage);
+	static const T* Get(const void* storage);
+	template<class... Args>
+	static T* Construct(void* storage, Args&&... args);
+	template<class... Args>
+	static T* ConstructIn(void* storage, MemoryResource* resource, Args&&... args);
+	static void CopyValue(const void* from, void* to);
+	static void MoveValue(void* from, void* to) noexcept;
+	static void DestroyValue(void* storage) noexcept;
+	void Copy(const void* from, void* to) const override;
+	void Move(void* from, void* to) const noexcept override;
+	void Destroy(void* storage) const noexcept override;
 };
 
 template <class T>
-Derived<T>::Derived(const T& other) : value_(other) {
+template <class... Args>
+HeapValue<T>::HeapValue(MemoryResource* resource, Args&&... args) :
+value_(std::forward<Args>(args)...), resource_(resource) {
 }
 
-template <class T>
-Derived<T>::Derived(T&& other) : value_(std::move(other)) {
+template <class T, bool Inline>
+const Derived<T, Inline> Derived<T, Inline>::kInstance;
+
+template <class T, bool Inline>
+T* Derived<T, Inline>::Get(void* storage) {
+	if constexpr (Inline) {
+		return std::launder(static_cast<T*>(storage));
+	} else {
+		return &(*static_cast<HeapValue<T>**>(storage))->value_;
+	}
 }
 
-template <class T>
-T Derived<T>::Get() const {
-	return value_;
+template <class T, bool Inline>
+const T* Derived<T, Inline>::Get(const void* storage) {
+	if constexpr (Inline) {
+		return std::launder(static_cast<const T*>(storage));
+	} else {
+		return &(*static_cast<HeapValue<T>* const*>(storage))->value_;
+	}
 }
 
-template <class T>
-std::unique_ptr<Base> Derived<T>::Clone() const {
-	return std::make_unique<Derived<T>>(value_);
+template <class T, bool Inline>
+template <class... Args>
+T* Derived<T, Inline>::Construct(void* storage, Args&&... args) {
+	return ConstructIn(storage, nullptr, std::forward<Args>(args)...);
 }
 
-class Any {
-	std::unique_ptr<Base> ptr_;
+// Inline values ignore the resource.
+template <class T, bool Inline>
+template <class... Args>
+T* Derived<T, Inline>::ConstructIn(void* storage, MemoryResource* resource, Args&&... args) {
+	if constexpr (Inline) {
+		return ::new (storage) T(std::forward<Args>(args)...);
+	} else {
+		void* mem = AllocateBytes(resource, sizeof(HeapValue<T>), alignof(HeapValue<T>));
+		HeapValue<T>* node;
+		try {
+			node = ::new (mem) HeapValue<T>(resource, std::forward<Args>(args)...);
+		} catch (...) {
+			DeallocateBytes(resource, mem, sizeof(HeapValue<T>), alignof(HeapValue<T>));
+			throw;
+		}
+		*static_cast<HeapValue<T>**>(storage) = node;
+		return &node->value_;
+	}
+}
+
+template <class T, bool Inline>
+void Derived<T, Inline>::CopyValue(const void* from, void* to) {
+	Construct(to, *Get(from));
+}
+
+template <class T, bool Inline>
+void Derived<T, Inline>::MoveValue(void* from, void* to) noexcept {
+	if constexpr (Inline) {
+		::new (to) T(std::move(*Get(from)));
+		Get(from)->~T();
+	} else {
+		*static_cast<HeapValue<T>**>(to) = *static_cast<HeapValue<T>**>(from);
+	}
+}
+
+template <class T, bool Inline>
+void Derived<T, Inline>::DestroyValue(void* storage) noexcept {
+	if constexpr (Inline) {
+		Get(storage)->~T();
+	} else {
+		HeapValue<T>* node = *static_cast<HeapValue<T>**>(storage);
+		MemoryResource* resource = node->resource_;
+		node->~HeapValue();
+		DeallocateBytes(resource, node, sizeof(HeapValue<T>), alignof(HeapValue<T>));
+	}
+}
+
+template <class T, bool Inline>
+void Derived<T, Inline>::Copy(const void* from, void* to) const {
+	CopyValue(from, to);
+}
+
+template <class T, bool Inline>
+void Derived<T, Inline>::Move(void* from, void* to) const noexcept {
+	MoveValue(from, to);
+}
+
+template <class T, bool Inline>
+void Derived<T, Inline>::Destroy(void* storage) const noexcept {
+	DestroyValue(storage);
+}
+
+template<class T>
+struct InPlaceType {
+	explicit InPlaceType() = default;
+};
+
+// Buffer that holds a value inline or, for values that do not fit, a pointer
+// to a heap-allocated one. Only nothrow-move-constructible types are stored
+// inline so that moving the owner never throws.
+template<size_t InlineSize>
+struct InlineStorage {
+	const static size_t kAlign = alignof(void*);
+	const static size_t kSize = InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize;
 
-public:
-	Any();
-	Any(const Any& other);
-	Any(Any&& other) noexcept = default;	
 	template<class T>
-	Any(const T& value);
+	struct Fits : std::integral_constant<bool, sizeof(T) <= kSize && kAlign % alignof(T) == 0 &&
+											   std::is_nothrow_move_constructible<T>::value> {
+	};
+
+	alignas(kAlign) unsigned char data_[kSize];
+};
+
+// Values that fit into InlineSize bytes are stored inside the Any; larger
+// types are heap-allocated, or allocated from the resource given to the
+// constructor. Copies always go to the heap.
+template<size_t InlineSize>
+class BasicAny {
+	InlineStorage<InlineSize> storage_;
+	const Base* handler_;
+
+public:
 	template<class T>
-	Any& operator=(const T& value);
-	Any& operator=(const Any& other);
-	Any& operator=(Any&& other) = default;
-	~Any() = default;
+	using FitsInline = typename InlineStorage<InlineSize>::template Fits<T>;
 
-	void Swap(Any& other);
+	BasicAny();
+	BasicAny(const BasicAny& other);
+	BasicAny(BasicAny&& other) noexcept;
+	template<class T, class = typename std::enable_if<!std::is_same<typename std::decay<T>::type, BasicAny>::value>::type>
+	BasicAny(T&& value);
+	template<class T, class... Args>
+	explicit BasicAny(InPlaceType<T>, Args&&... args);
+	template<class T, class... Args>
+	BasicAny(MemoryResource& resource, InPlaceType<T>, Args&&... args);
+	template<class T, class = typename std::enable_if<!std::is_same<typename std::decay<T>::type, BasicAny>::value>::type>
+	BasicAny& operator=(T&& value);
+	BasicAny& operator=(const BasicAny& other);
+	BasicAny& operator=(BasicAny&& other) noexcept;
+	~BasicAny();
+
+	template<class T, class... Args>
+	typename std::decay<T>::type& Emplace(Args&&... args);
+	void Swap(BasicAny& other);
 	void Reset();
 	bool HasValue() const;
 	template<class T>
-	friend T any_cast(const Any& value);
+	bool Holds() const;
+	template<class T>
+	T* Get();
+	template<class T>
+	const T* Get() const;
 };
 
-inline Any::Any() : ptr_(nullptr) {
+typedef BasicAny<3 * sizeof(void*)> Any;
+
+template <size_t InlineSize>
+BasicAny<InlineSize>::BasicAny() : handler_(nullptr) {
+}
+
+template <size_t InlineSize>
+BasicAny<InlineSize>::BasicAny(const BasicAny& other) : handler_(nullptr) {
+	if (other.handler_ != nullptr) {
+		other.handler_->Copy(other.storage_.data_, storage_.data_);
+		handler_ = other.handler_;
+	}
 }
 
-inline Any::Any(const Any& other) : ptr_(other.ptr_->Clone()) {
+template <size_t InlineSize>
+BasicAny<InlineSize>::BasicAny(BasicAny&& other) noexcept : handler_(other.handler_) {
+	if (handler_ != nullptr) {
+		handler_->Move(other.storage_.data_, storage_.data_);
+		other.handler_ = nullptr;
+	}
 }
 
-template <class T>
-Any::Any(const T& value) : ptr_(std::make_unique<Derived<T>>(value)) {
+template <size_t InlineSize>
+template <class T, class>
+BasicAny<InlineSize>::BasicAny(T&& value) : handler_(nullptr) {
+	Emplace<T>(std::forward<T>(value));
 }
 
-template <class T>
-Any& Any::operator=(const T& value) {
-	ptr_ = std::make_unique<Derived<T>>(value);
+template <size_t InlineSize>
+template <class T, class... Args>
+BasicAny<InlineSize>::BasicAny(InPlaceType<T>, Args&&... args) : handler_(nullptr) {
+	Emplace<T>(std::forward<Args>(args)...);
+}
+
+template <size_t InlineSize>
+template <class T, class... Args>
+BasicAny<InlineSize>::BasicAny(MemoryResource& resource, InPlaceType<T>, Args&&... args) : handler_(nullptr) {
+	typedef typename std::decay<T>::type Value;
+	typedef Derived<Value, FitsInline<Value>::value> Handler;
+	Handler::ConstructIn(storage_.data_, &resource, std::forward<Args>(args)...);
+	handler_ = &Handler::kInstance;
+}
+
+template <size_t InlineSize>
+template <class T, class>
+BasicAny<InlineSize>& BasicAny<InlineSize>::operator=(T&& value) {
+	BasicAny(std::forward<T>(value)).Swap(*this);
 	return *this;
 }
 
-inline Any& Any::operator=(const Any& other) {
+template <size_t InlineSize>
+template <class T, class... Args>
+typename std::decay<T>::type& BasicAny<InlineSize>::Emplace(Args&&... args) {
+	typedef typename std::decay<T>::type Value;
+	typedef Derived<Value, FitsInline<Value>::value> Handler;
+	Reset();
+	Value* value = Handler::Construct(storage_.data_, std::forward<Args>(args)...);
+	handler_ = &Handler::kInstance;
+	return *value;
+}
+
+template <size_t InlineSize>
+BasicAny<InlineSize>& BasicAny<InlineSize>::operator=(const BasicAny& other) {
 	if (this == &other) {
 		return *this;
 	}
-	ptr_ = other.ptr_->Clone();
+	BasicAny(other).Swap(*this);
 	return *this;
 }
 
-inline void Any::Swap(Any& other) {
-	std::swap(ptr_, other.ptr_);
+template <size_t InlineSize>
+BasicAny<InlineSize>& BasicAny<InlineSize>::operator=(BasicAny&& other) noexcept {
+	if (this == &other) {
+		return *this;
+	}
+	Reset();
+	if (other.handler_ != nullptr) {
+		other.handler_->Move(other.storage_.data_, storage_.data_);
+		handler_ = other.handler_;
+		other.handler_ = nullptr;
+	}
+	return *this;
+}
+
+template <size_t InlineSize>
+BasicAny<InlineSize>::~BasicAny() {
+	Reset();
+}
+
+template <size_t InlineSize>
+void BasicAny<InlineSize>::Swap(BasicAny& other) {
+	BasicAny tmp(std::move(other));
+	other = std::move(*this);
+	*this = std::move(tmp);
+}
+
+template <size_t InlineSize>
+bool BasicAny<InlineSize>::HasValue() const {
+	return handler_ != nullptr;
+}
+
+template <size_t InlineSize>
+void BasicAny<InlineSize>::Reset() {
+	if (handler_ != nullptr) {
+		handler_->Destroy(storage_.data_);
+		handler_ = nullptr;
+	}
 }
 
-inline bool Any::HasValue() const {
-	return ptr_ != nullptr;
+template <size_t InlineSize>
+template <class T>
+bool BasicAny<InlineSize>::Holds() const {
+	return handler_ == &Derived<T, FitsInline<T>::value>::kInstance;
 }
 
-inline void Any::Reset() {
-	ptr_ = nullptr;
+template <size_t InlineSize>
+template <class T>
+T* BasicAny<InlineSize>::Get() {
+	return Holds<T>() ? Derived<T, FitsInline<T>::value>::Get(storage_.data_) : nullptr;
 }
 
+template <size_t InlineSize>
 template <class T>
-T any_cast(const Any& value) {
-	if (dynamic_cast<Derived<T>*>(value.ptr_.get()) != nullptr) {
-		return dynamic_cast<Derived<T>*>(value.ptr_.get())->Get();
+const T* BasicAny<InlineSize>::Get() const {
+	return Holds<T>() ? Derived<T, FitsInline<T>::value>::Get(storage_.data_) : nullptr;
+}
+
+template <class T, size_t Size>
+const T* AnyCast(const BasicAny<Size>* value) noexcept {
+	return value == nullptr ? nullptr : value->template Get<T>();
+}
+
+template <class T, size_t Size>
+T* AnyCast(BasicAny<Size>* value) noexcept {
+	return value == nullptr ? nullptr : value->template Get<T>();
+}
+
+// T may be a reference type, in which case the stored value is returned
+// without a copy.
+template <class T, size_t Size>
+T AnyCast(const BasicAny<Size>& value) {
+	typedef typename std::remove_cv<typename std::remove_reference<T>::type>::type Value;
+	const Value* ptr = value.template Get<Value>();
+	if (ptr == nullptr) {
+		throw BadAnyCast();
+	}
+	return static_cast<T>(*ptr);
+}
+
+template <class T, size_t Size>
+T AnyCast(BasicAny<Size>& value) {
+	typedef typename std::remove_cv<typename std::remove_reference<T>::type>::type Value;
+	Value* ptr = value.template Get<Value>();
+	if (ptr == nullptr) {
+		throw BadAnyCast();
 	}
-	else {
+	return static_cast<T>(*ptr);
+}
+
+template <class T, size_t Size>
+T AnyCast(BasicAny<Size>&& value) {
+	typedef typename std::remove_cv<typename std::remove_reference<T>::type>::type Value;
+	Value* ptr = value.template Get<Value>();
+	if (ptr == nullptr) {
 		throw BadAnyCast();
 	}
+	return static_cast<T>(std::move(*ptr));
+}
+
+template <class T, size_t Size>
+T any_cast(const BasicAny<Size>& value) {
+	return AnyCast<T>(value);
 }
 
 #endif // ANY_H
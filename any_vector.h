@@ -0,0 +1,261 @@
+#ifndef ANY_VECTOR_H
+#define ANY_VECTOR_H
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "vector.h"
+
+// kId's address identifies T; Index() is a small number assigned to T on
+// first use, for direct lookup in per-type tables.
+template<class T>
+struct TypeTag {
+	static const char kId;
+	static size_t Index();
+};
+
+inline size_t NextTypeIndex() {
+	static std::atomic<size_t> next(0);
+	return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<class T>
+const char TypeTag<T>::kId = 0;
+
+template<class T>
+size_t TypeTag<T>::Index() {
+	static const size_t index = NextTypeIndex();
+	return index;
+}
+
+// One segment of an AnyVector: the array of all its elements of one type.
+// Get<T>() returns the array if the segment holds Ts, so a single type check
+// covers the whole segment.
+class AnySpan {
+	void* data_;
+	size_t size_;
+	const void* tag_;
+
+public:
+	AnySpan(void* data, size_t size, const void* tag);
+
+	template<class T>
+	bool Is() const;
+	template<class T>
+	T* Get() const;
+	size_t Size() const;
+};
+
+inline AnySpan::AnySpan(void* data, size_t size, const void* tag) : data_(data), size_(size), tag_(tag) {
+}
+
+template <class T>
+bool AnySpan::Is() const {
+	return tag_ == &TypeTag<T>::kId;
+}
+
+template <class T>
+T* AnySpan::Get() const {
+	return Is<T>() ? static_cast<T*>(data_) : nullptr;
+}
+
+inline size_t AnySpan::Size() const {
+	return size_;
+}
+
+// Heterogeneous collection that keeps the elements of each type in their own
+// contiguous Vector<T>. Iteration goes segment by segment, so per-type
+// ForEach runs a plain loop over one array; element types must satisfy the
+// requirements of Vector. Order of insertion is kept only within a type.
+// Segments are found through a table indexed by TypeTag<T>::Index(), so
+// Insert<T> and the other per-type calls do not search.
+class AnyVector {
+	class SegmentBase {
+	public:
+		virtual ~SegmentBase() = default;
+		virtual SegmentBase* Clone() const = 0;
+		virtual size_t Size() const = 0;
+		virtual void Clear() = 0;
+		virtual AnySpan Span() = 0;
+	};
+
+	template<class T>
+	class Segment : public SegmentBase {
+	public:
+		Vector<T> values_;
+
+		SegmentBase* Clone() const override;
+		size_t Size() const override;
+		void Clear() override;
+		AnySpan Span() override;
+	};
+
+	Vector<SegmentBase*> segments_;
+	// Position in segments_ plus one for each type index, 0 if there is no
+	// segment for the type.
+	Vector<size_t> slots_;
+
+	template<class T>
+	Segment<T>* Find() const;
+
+public:
+	AnyVector();
+	AnyVector(const AnyVector& other);
+	AnyVector& operator=(const AnyVector& other);
+	~AnyVector();
+
+	template<class T>
+	void Insert(const T& value);
+	template<class T>
+	Vector<T>& Values();
+	template<class T>
+	const Vector<T>* FindValues() const;
+	template<class T>
+	size_t Count() const;
+	size_t Size() const;
+	bool Empty() const;
+	void Clear();
+	void Swap(AnyVector& other);
+
+	// ForEach<A, B>(fn) calls fn(A&) for the A segment, then fn(B&) for the B
+	// segment, with static types; this is the fast path. ForEach(fn) without
+	// types calls fn(AnySpan) once per segment, and fn picks the type with
+	// Get<T>() and loops over the array itself.
+	template<class... Ts, class F>
+	void ForEach(F&& fn);
+};
+
+template <class T>
+AnyVector::SegmentBase* AnyVector::Segment<T>::Clone() const {
+	Segment* segment = new Segment();
+	segment->values_ = values_;
+	return segment;
+}
+
+template <class T>
+size_t AnyVector::Segment<T>::Size() const {
+	return values_.Size();
+}
+
+template <class T>
+void AnyVector::Segment<T>::Clear() {
+	values_.Clear();
+}
+
+template <class T>
+AnySpan AnyVector::Segment<T>::Span() {
+	return AnySpan(values_.Data(), values_.Size(), &TypeTag<T>::kId);
+}
+
+template <class T>
+AnyVector::Segment<T>* AnyVector::Find() const {
+	const size_t index = TypeTag<T>::Index();
+	if (index >= slots_.Size() || slots_[index] == 0) {
+		return nullptr;
+	}
+	return static_cast<Segment<T>*>(segments_[slots_[index] - 1]);
+}
+
+inline AnyVector::AnyVector() {
+}
+
+inline AnyVector::AnyVector(const AnyVector& other) : slots_(other.slots_) {
+	for (size_t i = 0; i < other.segments_.Size(); ++i) {
+		segments_.PushBack(other.segments_[i]->Clone());
+	}
+}
+
+inline AnyVector& AnyVector::operator=(const AnyVector& other) {
+	if (this == &other) {
+		return *this;
+	}
+	AnyVector copy(other);
+	Swap(copy);
+	return *this;
+}
+
+inline AnyVector::~AnyVector() {
+	for (size_t i = 0; i < segments_.Size(); ++i) {
+		delete segments_[i];
+	}
+}
+
+template <class T>
+void AnyVector::Insert(const T& value) {
+	Values<T>().PushBack(value);
+}
+
+template <class T>
+Vector<T>& AnyVector::Values() {
+	Segment<T>* segment = Find<T>();
+	if (segment == nullptr) {
+		const size_t index = TypeTag<T>::Index();
+		if (index >= slots_.Size()) {
+			slots_.Resize(index + 1, 0);
+		}
+		segment = new Segment<T>();
+		segments_.PushBack(segment);
+		slots_[index] = segments_.Size();
+	}
+	return segment->values_;
+}
+
+template <class T>
+const Vector<T>* AnyVector::FindValues() const {
+	const Segment<T>* segment = Find<T>();
+	return segment == nullptr ? nullptr : &segment->values_;
+}
+
+template <class T>
+size_t AnyVector::Count() const {
+	const Segment<T>* segment = Find<T>();
+	return segment == nullptr ? 0 : segment->Size();
+}
+
+inline size_t AnyVector::Size() const {
+	size_t size = 0;
+	for (size_t i = 0; i < segments_.Size(); ++i) {
+		size += segments_[i]->Size();
+	}
+	return size;
+}
+
+inline bool AnyVector::Empty() const {
+	return Size() == 0;
+}
+
+inline void AnyVector::Clear() {
+	for (size_t i = 0; i < segments_.Size(); ++i) {
+		segments_[i]->Clear();
+	}
+}
+
+inline void AnyVector::Swap(AnyVector& other) {
+	segments_.Swap(other.segments_);
+	slots_.Swap(other.slots_);
+}
+
+template <class... Ts, class F>
+void AnyVector::ForEach(F&& fn) {
+	if constexpr (sizeof...(Ts) == 0) {
+		for (size_t i = 0; i < segments_.Size(); ++i) {
+			fn(segments_[i]->Span());
+		}
+	} else {
+		auto visit_segment = [this, &fn](auto* type) {
+			typedef typename std::remove_pointer<decltype(type)>::type T;
+			Segment<T>* segment = Find<T>();
+			if (segment == nullptr) {
+				return;
+			}
+			Vector<T>& values = segment->values_;
+			const size_t size = values.Size();
+			for (size_t i = 0; i < size; ++i) {
+				fn(values[i]);
+			}
+		};
+		(visit_segment(static_cast<Ts*>(nullptr)), ...);
+	}
+}
+
+#endif // ANY_VECTOR_H
@@ -0,0 +1,398 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
+#include "memory_resource.h"
+#include "shared_ptr.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define ARENA_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ARENA_ASAN 1
+#endif
+#endif
+
+#ifdef ARENA_ASAN
+#include <sanitizer/asan_interface.h>
+#define ARENA_POISON(ptr, size) ASAN_POISON_MEMORY_REGION(ptr, size)
+#define ARENA_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+#define ARENA_POISON(ptr, size) ((void)(ptr), (void)(size))
+#define ARENA_UNPOISON(ptr, size) ((void)(ptr), (void)(size))
+#endif
+
+// Header at the start of every arena block; the payload starts kHeaderSize
+// bytes in.
+struct ArenaBlock {
+	const static size_t kHeaderSize = 64;
+
+	ArenaBlock* next_;
+	size_t size_;
+	bool huge_;
+
+	char* Begin();
+	char* End();
+};
+
+inline thread_local bool arena_block_cache_dead = false;
+
+// Per-thread list of released blocks, so that arenas created or reset for
+// every request reuse their blocks instead of going back to the heap (or to
+// mmap for huge pages). Holds up to kMaxCachedBytes; blocks beyond that are
+// freed.
+class ArenaBlockCache {
+	const static size_t kMaxCachedBytes = 32 << 20;
+	const static size_t kHugePageSize = 2 << 20;
+
+	ArenaBlock* free_;
+	size_t cached_;
+
+	static ArenaBlockCache* Current();
+	static ArenaBlock* Map(size_t size, bool huge);
+
+public:
+	ArenaBlockCache();
+	ArenaBlockCache(const ArenaBlockCache& other) = delete;
+	ArenaBlockCache& operator=(const ArenaBlockCache& other) = delete;
+	~ArenaBlockCache();
+
+	static ArenaBlock* Acquire(size_t size, bool huge);
+	static void Release(ArenaBlock* block);
+	static void Free(ArenaBlock* block);
+};
+
+// Monotonic memory resource: allocation bumps a pointer through the current
+// block, Deallocate does nothing, and Reset frees everything at once.
+// Blocks of block_size bytes are chained as needed; allocations larger than
+// a quarter of a block get a block of their own. Reset keeps the newest
+// block and hands the others to the thread's ArenaBlockCache.
+//
+//   Arena arena;
+//   Vector<int> ids(arena);
+//   CircularBuffer<Event> events(arena);
+//   Any extra(arena, InPlaceType<Payload>(), ...);
+//   SharedPtr<Session> session = arena.MakeShared<Session>(...);
+//   ...
+//   arena.Reset();
+//
+// Everything built on the arena must be gone before Reset, which should run
+// on the thread that built it; destructors still run as usual, and are not
+// run by Reset. Copies of arena-built containers
+// allocate from the heap. An Arena is not thread-safe, but Deallocate may be
+// called from any thread.
+//
+// kHugePages backs blocks with 2 MiB-aligned mappings advised for
+// transparent huge pages, rounding the block size up to 2 MiB. kPoison fills
+// new allocations with kAllocatedByte and released memory with kFreedByte; it
+// is on by default in debug builds. Under AddressSanitizer, memory that is
+// not currently allocated is always poisoned.
+class Arena final : public MemoryResource {
+	template <class T>
+	struct Destroy {
+		void operator()(T* ptr) const;
+	};
+
+	ArenaBlock* blocks_;
+	char* ptr_;
+	char* end_;
+	size_t block_size_;
+	int flags_;
+	size_t allocated_;
+	size_t reserved_;
+
+	void* AllocateSlow(size_t size, size_t align);
+	void* Take(char* ptr, size_t size);
+	void ReleaseBlock(ArenaBlock* block, char* used_end);
+
+public:
+	enum Flags {
+		kDefault = 0,
+		kHugePages = 1,
+		kPoison = 2,
+	};
+#ifdef NDEBUG
+	const static int kDefaultFlags = kDefault;
+#else
+	const static int kDefaultFlags = kPoison;
+#endif
+	const static size_t kDefaultBlockSize = 64 << 10;
+	const static size_t kHugePageSize = 2 << 20;
+	const static unsigned char kAllocatedByte = 0xCD;
+	const static unsigned char kFreedByte = 0xDD;
+
+	explicit Arena(size_t block_size = kDefaultBlockSize, int flags = kDefaultFlags);
+	Arena(const Arena& other) = delete;
+	Arena& operator=(const Arena& other) = delete;
+	~Arena() override;
+
+	void* Allocate(size_t size, size_t align = alignof(std::max_align_t)) override;
+	void Deallocate(void* ptr, size_t size, size_t align) noexcept override;
+	template <class T, class... Args>
+	T* New(Args&&... args);
+	template <class T, class... Args>
+	SharedPtr<T> MakeShared(Args&&... args);
+	void Reset();
+	size_t BytesAllocated() const;
+	size_t BytesReserved() const;
+};
+
+inline char* ArenaBlock::Begin() {
+	return reinterpret_cast<char*>(this) + kHeaderSize;
+}
+
+inline char* ArenaBlock::End() {
+	return reinterpret_cast<char*>(this) + size_;
+}
+
+inline ArenaBlockCache* ArenaBlockCache::Current() {
+	if (arena_block_cache_dead) {
+		return nullptr;
+	}
+	thread_local ArenaBlockCache cache;
+	return &cache;
+}
+
+// Huge blocks are mapped with 2 MiB of slack and trimmed to a 2 MiB boundary,
+// so that the kernel can back them with whole huge pages.
+inline ArenaBlock* ArenaBlockCache::Map(size_t size, bool huge) {
+	void* mem;
+	if (huge) {
+		const size_t len = size + kHugePageSize;
+		void* raw = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (raw == MAP_FAILED) {
+			throw std::bad_alloc();
+		}
+		const uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+		const uintptr_t aligned = (begin + kHugePageSize - 1) & ~(kHugePageSize - 1);
+		if (aligned != begin) {
+			munmap(raw, aligned - begin);
+		}
+		if (begin + len != aligned + size) {
+			munmap(reinterpret_cast<void*>(aligned + size), begin + len - aligned - size);
+		}
+		mem = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+		madvise(mem, size, MADV_HUGEPAGE);
+#endif
+	} else {
+		mem = ::operator new(size);
+	}
+	ArenaBlock* block = static_cast<ArenaBlock*>(mem);
+	block->next_ = nullptr;
+	block->size_ = size;
+	block->huge_ = huge;
+	return block;
+}
+
+inline ArenaBlockCache::ArenaBlockCache() : free_(nullptr), cached_(0) {
+}
+
+inline ArenaBlockCache::~ArenaBlockCache() {
+	arena_block_cache_dead = true;
+	while (free_ != nullptr) {
+		ArenaBlock* block = free_;
+		free_ = block->next_;
+		Free(block);
+	}
+}
+
+inline ArenaBlock* ArenaBlockCache::Acquire(size_t size, bool huge) {
+	ArenaBlockCache* cache = Current();
+	if (cache != nullptr) {
+		for (ArenaBlock** link = &cache->free_; *link != nullptr; link = &(*link)->next_) {
+			ArenaBlock* block = *link;
+			if (block->size_ == size && block->huge_ == huge) {
+				*link = block->next_;
+				cache->cached_ -= size;
+				block->next_ = nullptr;
+				return block;
+			}
+		}
+	}
+	return Map(size, huge);
+}
+
+inline void ArenaBlockCache::Release(ArenaBlock* block) {
+	ArenaBlockCache* cache = Current();
+	if (cache == nullptr || cache->cached_ + block->size_ > kMaxCachedBytes) {
+		Free(block);
+		return;
+	}
+	block->next_ = cache->free_;
+	cache->free_ = block;
+	cache->cached_ += block->size_;
+}
+
+inline void ArenaBlockCache::Free(ArenaBlock* block) {
+	ARENA_UNPOISON(block->Begin(), block->size_ - ArenaBlock::kHeaderSize);
+	if (block->huge_) {
+		munmap(block, block->size_);
+	} else {
+		::operator delete(block);
+	}
+}
+
+template <class T>
+void Arena::Destroy<T>::operator()(T* ptr) const {
+	ptr->~T();
+}
+
+inline Arena::Arena(size_t block_size, int flags) :
+blocks_(nullptr), ptr_(nullptr), end_(nullptr), flags_(flags), allocated_(0), reserved_(0) {
+	if (block_size < 4 * ArenaBlock::kHeaderSize) {
+		block_size = 4 * ArenaBlock::kHeaderSize;
+	}
+	if (flags_ & kHugePages) {
+		block_size = (block_size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+	}
+	block_size_ = block_size;
+}
+
+inline Arena::~Arena() {
+	MergeBiasedCounters();
+	while (blocks_ != nullptr) {
+		ArenaBlock* block = blocks_;
+		blocks_ = block->next_;
+		ReleaseBlock(block, block->End());
+	}
+}
+
+inline void* Arena::Take(char* ptr, size_t size) {
+	ARENA_UNPOISON(ptr, size);
+	if (flags_ & kPoison) {
+		memset(ptr, kAllocatedByte, size);
+	}
+	allocated_ += size;
+	return ptr;
+}
+
+// align must be a power of two.
+inline void* Arena::Allocate(size_t size, size_t align) {
+	const size_t pad = (0 - reinterpret_cast<uintptr_t>(ptr_)) & (align - 1);
+	const size_t avail = static_cast<size_t>(end_ - ptr_);
+	if (size > avail || pad > avail - size) {
+		return AllocateSlow(size, align);
+	}
+	char* ptr = ptr_ + pad;
+	ptr_ = ptr + size;
+	return Take(ptr, size);
+}
+
+inline void* Arena::AllocateSlow(size_t size, size_t align) {
+	const size_t payload = block_size_ - ArenaBlock::kHeaderSize;
+	if (size > SIZE_MAX - align - block_size_) {
+		throw std::bad_alloc();
+	}
+	const bool huge = (flags_ & kHugePages) != 0;
+	if (size + align > payload / 4) {
+		size_t block_size = ArenaBlock::kHeaderSize + size + align;
+		if (huge) {
+			block_size = (block_size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+		}
+		ArenaBlock* block = ArenaBlockCache::Acquire(block_size, huge);
+		ARENA_POISON(block->Begin(), block->size_ - ArenaBlock::kHeaderSize);
+		reserved_ += block->size_;
+		// Linked behind the current block, which stays open for small allocations.
+		if (blocks_ == nullptr) {
+			blocks_ = block;
+		} else {
+			block->next_ = blocks_->next_;
+			blocks_->next_ = block;
+		}
+		const uintptr_t begin = reinterpret_cast<uintptr_t>(block->Begin());
+		return Take(reinterpret_cast<char*>((begin + align - 1) & ~(align - 1)), size);
+	}
+	ArenaBlock* block = ArenaBlockCache::Acquire(block_size_, huge);
+	ARENA_POISON(block->Begin(), payload);
+	reserved_ += block->size_;
+	block->next_ = blocks_;
+	blocks_ = block;
+	ptr_ = block->Begin();
+	end_ = block->End();
+	return Allocate(size, align);
+}
+
+inline void Arena::Deallocate(void* ptr, size_t size, size_t align) noexcept {
+	static_cast<void>(align);
+	if (flags_ & kPoison) {
+		memset(ptr, kFreedByte, size);
+	}
+	ARENA_POISON(ptr, size);
+}
+
+inline void Arena::ReleaseBlock(ArenaBlock* block, char* used_end) {
+	if (flags_ & kPoison) {
+		ARENA_UNPOISON(block->Begin(), used_end - block->Begin());
+		memset(block->Begin(), kFreedByte, used_end - block->Begin());
+	}
+	ARENA_POISON(block->Begin(), block->size_ - ArenaBlock::kHeaderSize);
+	if (block->size_ == block_size_) {
+		ArenaBlockCache::Release(block);
+	} else {
+		ArenaBlockCache::Free(block);
+	}
+}
+
+template <class T, class... Args>
+T* Arena::New(Args&&... args) {
+	return ::new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+// The object and its control block both live in the arena.
+template <class T, class... Args>
+SharedPtr<T> Arena::MakeShared(Args&&... args) {
+	return SharedPtr<T>(New<T>(std::forward<Args>(args)...), Destroy<T>(), ResourceAllocator<T>(this));
+}
+
+// Keeps the block being bumped through. Objects from MakeShared whose last
+// reference was dropped on another thread are queued to this thread by
+// SharedPtr, so they are released first.
+inline void Arena::Reset() {
+	MergeBiasedCounters();
+	ArenaBlock* keep = blocks_;
+	if (keep == nullptr) {
+		return;
+	}
+	ArenaBlock* block = keep->next_;
+	while (block != nullptr) {
+		ArenaBlock* next = block->next_;
+		ReleaseBlock(block, block->End());
+		block = next;
+	}
+	keep->next_ = nullptr;
+	if (ptr_ < keep->Begin() || ptr_ > keep->End()) {
+		ReleaseBlock(keep, keep->End());
+		keep = nullptr;
+	}
+	blocks_ = keep;
+	allocated_ = 0;
+	if (keep == nullptr) {
+		ptr_ = end_ = nullptr;
+		reserved_ = 0;
+		return;
+	}
+	if (flags_ & kPoison) {
+		ARENA_UNPOISON(keep->Begin(), ptr_ - keep->Begin());
+		memset(keep->Begin(), kFreedByte, ptr_ - keep->Begin());
+	}
+	ARENA_POISON(keep->Begin(), keep->size_ - ArenaBlock::kHeaderSize);
+	ptr_ = keep->Begin();
+	end_ = keep->End();
+	reserved_ = keep->size_;
+}
+
+inline size_t Arena::BytesAllocated() const {
+	return allocated_;
+}
+
+inline size_t Arena::BytesReserved() const {
+	return reserved_;
+}
+
+#endif
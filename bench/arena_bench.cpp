@@ -0,0 +1,85 @@
+// Allocation for one simulated request: a handful of Vectors, Anys, SharedPtrs
+// and a CircularBuffer, built on the global heap or on an Arena that is reset
+// after every request. One iteration is one request.
+
+#include <cstdint>
+#include "any.h"
+#include "arena.h"
+#include "bench.h"
+#include "circular_buffer.h"
+#include "shared_ptr.h"
+#include "vector.h"
+
+struct Record {
+	int64_t id_;
+	int64_t values_[6];
+};
+
+static int64_t BuildRequest(MemoryResource* resource) {
+	int64_t sum = 0;
+	for (int v = 0; v < 16; ++v) {
+		Vector<int64_t> ids = resource == nullptr ? Vector<int64_t>() : Vector<int64_t>(*resource);
+		for (int64_t i = 0; i < 24; ++i) {
+			ids.PushBack(i);
+		}
+		sum += ids[ids.Size() - 1];
+	}
+	for (int a = 0; a < 4; ++a) {
+		Any value = resource == nullptr ? Any(InPlaceType<Record>(), Record{a, {}})
+										: Any(*resource, InPlaceType<Record>(), Record{a, {}});
+		sum += AnyCast<Record&>(value).id_;
+	}
+	CircularBuffer<int64_t> events = resource == nullptr ? CircularBuffer<int64_t>() : CircularBuffer<int64_t>(*resource);
+	for (int64_t i = 0; i < 64; ++i) {
+		events.PushBack(i);
+	}
+	sum += events.Size();
+	return sum;
+}
+
+static void HeapRequestBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		int64_t sum = BuildRequest(nullptr);
+		for (int s = 0; s < 4; ++s) {
+			SharedPtr<Record> record(new Record{s, {}});
+			sum += record->id_;
+		}
+		DoNotOptimize(sum);
+	}
+}
+
+static void ArenaRequestBench(BenchState& state) {
+	Arena arena(Arena::kDefaultBlockSize, Arena::kDefault);
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		int64_t sum = BuildRequest(&arena);
+		for (int s = 0; s < 4; ++s) {
+			SharedPtr<Record> record = arena.MakeShared<Record>(Record{s, {}});
+			sum += record->id_;
+		}
+		DoNotOptimize(sum);
+		arena.Reset();
+	}
+}
+
+static void ArenaAllocateBench(BenchState& state) {
+	Arena arena(Arena::kDefaultBlockSize, Arena::kDefault);
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		DoNotOptimize(arena.Allocate(static_cast<size_t>(state.Arg()), 8));
+		if (arena.BytesAllocated() > (32 << 10)) {
+			arena.Reset();
+		}
+	}
+}
+
+static void HeapAllocateBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		void* ptr = ::operator new(static_cast<size_t>(state.Arg()));
+		DoNotOptimize(ptr);
+		::operator delete(ptr);
+	}
+}
+
+const BenchRegistrar kHeapRequest("arena/request/heap", &HeapRequestBench);
+const BenchRegistrar kArenaRequest("arena/request/Arena", &ArenaRequestBench);
+const BenchRegistrar kArenaAllocate("arena/allocate/Arena", &ArenaAllocateBench, {16, 256});
+const BenchRegistrar kHeapAllocate("arena/allocate/operator_new", &HeapAllocateBench, {16, 256});
@@ -0,0 +1,99 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness. A benchmark is a function that runs its body
+// state.Iterations() times; the runner picks the iteration count so that one
+// repetition takes at least the minimum time and reports the median time per
+// iteration over several repetitions.
+class BenchState {
+	size_t iterations_;
+	int64_t arg_;
+
+public:
+	BenchState(size_t iterations, int64_t arg);
+
+	size_t Iterations() const;
+	int64_t Arg() const;
+};
+
+typedef void (*BenchFn)(BenchState& state);
+
+struct BenchInfo {
+	std::string name_;
+	BenchFn fn_;
+	int64_t arg_;
+};
+
+class BenchRegistry {
+	std::vector<BenchInfo> benchmarks_;
+
+public:
+	static BenchRegistry& Instance();
+
+	void Add(const std::string& name, BenchFn fn, int64_t arg);
+	const std::vector<BenchInfo>& Benchmarks() const;
+};
+
+// Registers fn once per argument, named "name/arg" (or just "name" when args
+// is empty). Meant to be used for namespace-scope constants.
+class BenchRegistrar {
+public:
+	BenchRegistrar(const char* name, BenchFn fn, std::vector<int64_t> args = {});
+};
+
+// Number of calls to the global operator new made by any thread so far. The
+// runner replaces operator new to count them, and reports the count per
+// iteration, so allocations on worker threads a benchmark starts are included.
+size_t AllocationCount();
+
+// Keeps the compiler from discarding a computed value or from assuming memory
+// is unchanged across the call.
+template <class T>
+inline void DoNotOptimize(const T& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void ClobberMemory() {
+	asm volatile("" : : : "memory");
+}
+
+inline BenchState::BenchState(size_t iterations, int64_t arg) : iterations_(iterations), arg_(arg) {
+}
+
+inline size_t BenchState::Iterations() const {
+	return iterations_;
+}
+
+inline int64_t BenchState::Arg() const {
+	return arg_;
+}
+
+inline BenchRegistry& BenchRegistry::Instance() {
+	static BenchRegistry registry;
+	return registry;
+}
+
+inline void BenchRegistry::Add(const std::string& name, BenchFn fn, int64_t arg) {
+	benchmarks_.push_back(BenchInfo{name, fn, arg});
+}
+
+inline const std::vector<BenchInfo>& BenchRegistry::Benchmarks() const {
+	return benchmarks_;
+}
+
+inline BenchRegistrar::BenchRegistrar(const char* name, BenchFn fn, std::vector<int64_t> args) {
+	if (args.empty()) {
+		BenchRegistry::Instance().Add(name, fn, 0);
+		return;
+	}
+	for (size_t i = 0; i < args.size(); ++i) {
+		BenchRegistry::Instance().Add(std::string(name) + "/" + std::to_string(args[i]), fn, args[i]);
+	}
+}
+
+#endif
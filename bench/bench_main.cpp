@@ -0,0 +1,224 @@
+// Benchmark runner.
+//
+//   bench [--filter=SUBSTR] [--min-time=SECONDS] [--repetitions=N]
+//         [--json=FILE] [--baseline=FILE] [--threshold=FRACTION]
+//
+// Results are printed as a table and, with --json, written as JSON with one
+// benchmark object per line. With --baseline the results are compared
+// against an earlier JSON file, and the exit status is 1 if any benchmark got
+// slower by more than the threshold (default 0.10). allocs/op counts calls to
+// the global operator new from every thread, including the workers of
+// multithreaded benchmarks.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "mapped_file.h"
+#include "string_convert.h"
+#include "string_split.h"
+
+static std::atomic<size_t> allocation_count(0);
+
+size_t AllocationCount() {
+	return allocation_count.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	void* ptr = malloc(size == 0 ? 1 : size);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+struct BenchOptions {
+	std::string filter_;
+	double min_time_ = 0.05;
+	size_t repetitions_ = 5;
+	std::string json_;
+	std::string baseline_;
+	double threshold_ = 0.10;
+};
+
+struct BenchResult {
+	std::string name_;
+	size_t iterations_;
+	double ns_per_op_;
+	double min_ns_per_op_;
+	double allocs_per_op_;
+};
+
+static double RunOnce(const BenchInfo& info, size_t iterations) {
+	BenchState state(iterations, info.arg_);
+	const auto start = std::chrono::steady_clock::now();
+	info.fn_(state);
+	const auto stop = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(stop - start).count();
+}
+
+static BenchResult Run(const BenchInfo& info, const BenchOptions& options) {
+	size_t iterations = 1;
+	while (true) {
+		const double elapsed = RunOnce(info, iterations);
+		if (elapsed >= options.min_time_ || iterations >= (size_t(1) << 40)) {
+			break;
+		}
+		const double scale = elapsed <= 0 ? 100 : std::min(100.0, 1.4 * options.min_time_ / elapsed);
+		iterations = std::max(iterations + 1, static_cast<size_t>(iterations * scale));
+	}
+	std::vector<double> samples;
+	const size_t allocations = AllocationCount();
+	for (size_t i = 0; i < options.repetitions_; ++i) {
+		samples.push_back(RunOnce(info, iterations) * 1e9 / iterations);
+	}
+	const double allocs_per_op = static_cast<double>(AllocationCount() - allocations) / (iterations * options.repetitions_);
+	std::sort(samples.begin(), samples.end());
+	return BenchResult{info.name_, iterations, samples[samples.size() / 2], samples[0], allocs_per_op};
+}
+
+static std::string JsonEscape(const std::string& str) {
+	std::string out;
+	for (char c : str) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+		}
+		out += c;
+	}
+	return out;
+}
+
+static void WriteJson(const std::string& path, const std::vector<BenchResult>& results) {
+	std::ofstream out(path);
+	out << "{\n";
+	out << "  \"context\": {\"compiler\": \"" << JsonEscape(__VERSION__) << "\", \"hardware_threads\": "
+		<< std::thread::hardware_concurrency() << "},\n";
+	out << "  \"benchmarks\": [\n";
+	char buf[kMaxFormatChars];
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchResult& r = results[i];
+		out << "    {\"name\": \"" << JsonEscape(r.name_) << "\", \"iterations\": " << r.iterations_;
+		out << ", \"ns_per_op\": " << std::string(buf, FormatDouble(r.ns_per_op_, buf, sizeof(buf)));
+		out << ", \"min_ns_per_op\": " << std::string(buf, FormatDouble(r.min_ns_per_op_, buf, sizeof(buf)));
+		out << ", \"allocs_per_op\": " << std::string(buf, FormatDouble(r.allocs_per_op_, buf, sizeof(buf))) << "}";
+		out << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  ]\n}\n";
+}
+
+// Reads the files written by WriteJson: one benchmark object per line.
+static std::map<std::string, double> ReadBaseline(const std::string& path) {
+	std::map<std::string, double> baseline;
+	MappedFile file(path.c_str());
+	const StringView kName("\"name\": \"");
+	const StringView kTime("\"ns_per_op\": ");
+	for (StringView line : Lines(file.View())) {
+		const size_t name = line.Find(kName);
+		const size_t time = line.Find(kTime);
+		if (name == StringView::kNpos || time == StringView::kNpos) {
+			continue;
+		}
+		const size_t name_begin = name + kName.Size();
+		const size_t name_end = line.Find('"', name_begin);
+		const size_t time_begin = time + kTime.Size();
+		const size_t time_end = line.FindFirstOf(",}", time_begin);
+		if (name_end == StringView::kNpos || time_end == StringView::kNpos) {
+			continue;
+		}
+		const ParseResult<double> ns = ParseDouble(line.Substr(time_begin, time_end - time_begin));
+		if (ns) {
+			const StringView key = line.Substr(name_begin, name_end - name_begin);
+			baseline[std::string(key.Data(), key.Size())] = ns.Value();
+		}
+	}
+	return baseline;
+}
+
+static bool ParseFlag(const char* arg, const char* flag, std::string* value) {
+	const size_t len = strlen(flag);
+	if (strncmp(arg, flag, len) != 0 || arg[len] != '=') {
+		return false;
+	}
+	*value = arg + len + 1;
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	for (int i = 1; i < argc; ++i) {
+		std::string value;
+		if (ParseFlag(argv[i], "--filter", &value)) {
+			options.filter_ = value;
+		} else if (ParseFlag(argv[i], "--min-time", &value)) {
+			options.min_time_ = ParseDouble(StringView(value.data(), value.size())).ValueOr(options.min_time_);
+		} else if (ParseFlag(argv[i], "--repetitions", &value)) {
+			options.repetitions_ = ParseUInt<size_t>(StringView(value.data(), value.size())).ValueOr(options.repetitions_);
+		} else if (ParseFlag(argv[i], "--json", &value)) {
+			options.json_ = value;
+		} else if (ParseFlag(argv[i], "--baseline", &value)) {
+			options.baseline_ = value;
+		} else if (ParseFlag(argv[i], "--threshold", &value)) {
+			options.threshold_ = ParseDouble(StringView(value.data(), value.size())).ValueOr(options.threshold_);
+		} else {
+			fprintf(stderr, "unknown argument: %s\n", argv[i]);
+			return 2;
+		}
+	}
+	if (options.repetitions_ == 0) {
+		options.repetitions_ = 1;
+	}
+
+	std::map<std::string, double> baseline;
+	if (!options.baseline_.empty()) {
+		baseline = ReadBaseline(options.baseline_);
+	}
+
+	std::vector<BenchResult> results;
+	size_t regressions = 0;
+	printf("%-56s %14s %12s %10s", "benchmark", "iterations", "ns/op", "allocs/op");
+	printf(baseline.empty() ? "\n" : " %12s %8s\n", "baseline", "change");
+	for (const BenchInfo& info : BenchRegistry::Instance().Benchmarks()) {
+		if (info.name_.find(options.filter_) == std::string::npos) {
+			continue;
+		}
+		const BenchResult result = Run(info, options);
+		results.push_back(result);
+		printf("%-56s %14zu %12.2f %10.2f", result.name_.c_str(), result.iterations_, result.ns_per_op_, result.allocs_per_op_);
+		const auto it = baseline.find(result.name_);
+		if (it != baseline.end() && it->second > 0) {
+			const double change = result.ns_per_op_ / it->second - 1;
+			const bool regressed = change > options.threshold_;
+			regressions += regressed;
+			printf(" %12.2f %+7.1f%%%s", it->second, change * 100, regressed ? "  REGRESSION" : "");
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	if (!options.json_.empty()) {
+		WriteJson(options.json_, results);
+	}
+	if (regressions != 0) {
+		printf("%zu benchmark(s) regressed by more than %.0f%%\n", regressions, options.threshold_ * 100);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,183 @@
+// Coroutine channels against a mutex/condition-variable CircularBuffer
+// queue passing the same messages between threads. One iteration is one
+// message (ping-pong: one round trip).
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "channel.h"
+#include "circular_buffer.h"
+
+// Coroutine that starts eagerly and frees itself when it finishes.
+struct Detached {
+	struct promise_type {
+		Detached get_return_object() {
+			return Detached();
+		}
+		std::suspend_never initial_suspend() noexcept {
+			return std::suspend_never();
+		}
+		std::suspend_never final_suspend() noexcept {
+			return std::suspend_never();
+		}
+		void return_void() {
+		}
+		void unhandled_exception() {
+			std::terminate();
+		}
+	};
+};
+
+// The thread handoff baseline.
+template <class T>
+class BlockingQueue {
+	CircularBuffer<T> buffer_;
+	size_t capacity_;
+	std::mutex mutex_;
+	std::condition_variable not_empty_;
+	std::condition_variable not_full_;
+
+public:
+	explicit BlockingQueue(size_t capacity) : capacity_(capacity) {
+	}
+
+	void Push(const T& value) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_full_.wait(lock, [this] { return buffer_.Size() < capacity_; });
+		buffer_.PushBack(value);
+		not_empty_.notify_one();
+	}
+
+	T Pop() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		not_empty_.wait(lock, [this] { return !buffer_.Empty(); });
+		const T value = buffer_.Front();
+		buffer_.PopFront();
+		not_full_.notify_one();
+		return value;
+	}
+};
+
+template <class Ch>
+Detached Ping(Ch& ping, Ch& pong, size_t count, int64_t* sum) {
+	for (size_t i = 0; i < count; ++i) {
+		co_await ping.Send(static_cast<int64_t>(i));
+		*sum += *co_await pong.Receive();
+	}
+}
+
+template <class Ch>
+Detached Pong(Ch& ping, Ch& pong) {
+	while (std::optional<int64_t> value = co_await ping.Receive()) {
+		co_await pong.Send(*value + 1);
+	}
+}
+
+// Arg() is the channel capacity; waiters are resumed inline.
+template <ChannelMode Mode>
+void PingPongBench(BenchState& state) {
+	Channel<int64_t, Mode> ping(static_cast<size_t>(state.Arg()));
+	Channel<int64_t, Mode> pong(static_cast<size_t>(state.Arg()));
+	int64_t sum = 0;
+	Pong(ping, pong);
+	Ping(ping, pong, state.Iterations(), &sum);
+	ping.Close();
+	DoNotOptimize(sum);
+}
+
+// Waiters go through a ResumeQueue instead of being resumed inline.
+void PingPongQueuedBench(BenchState& state) {
+	ResumeQueue queue;
+	const auto post = [&queue](std::coroutine_handle<> handle) { queue.Post(handle); };
+	Channel<int64_t> ping(static_cast<size_t>(state.Arg()), post);
+	Channel<int64_t> pong(static_cast<size_t>(state.Arg()), post);
+	int64_t sum = 0;
+	Pong(ping, pong);
+	Ping(ping, pong, state.Iterations(), &sum);
+	queue.Run();
+	ping.Close();
+	queue.Run();
+	DoNotOptimize(sum);
+}
+
+void PingPongThreadBench(BenchState& state) {
+	BlockingQueue<int64_t> ping(1);
+	BlockingQueue<int64_t> pong(1);
+	const size_t count = state.Iterations();
+	std::thread other([&ping, &pong, count] {
+		for (size_t i = 0; i < count; ++i) {
+			pong.Push(ping.Pop() + 1);
+		}
+	});
+	int64_t sum = 0;
+	for (size_t i = 0; i < count; ++i) {
+		ping.Push(static_cast<int64_t>(i));
+		sum += pong.Pop();
+	}
+	other.join();
+	DoNotOptimize(sum);
+}
+
+template <class Ch>
+Detached Produce(Ch& ch, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		co_await ch.Send(static_cast<int64_t>(i));
+	}
+}
+
+template <class Ch>
+Detached Consume(Ch& ch, int64_t* sum) {
+	while (std::optional<int64_t> value = co_await ch.Receive()) {
+		*sum += *value;
+	}
+}
+
+// Arg() producers feed one consumer through a channel of capacity 64.
+void FanInBench(BenchState& state) {
+	ResumeQueue queue;
+	Channel<int64_t> ch(64, [&queue](std::coroutine_handle<> handle) { queue.Post(handle); });
+	const size_t producers = static_cast<size_t>(state.Arg());
+	int64_t sum = 0;
+	Consume(ch, &sum);
+	for (size_t p = 0; p < producers; ++p) {
+		Produce(ch, state.Iterations() / producers + (p < state.Iterations() % producers));
+	}
+	queue.Run();
+	ch.Close();
+	queue.Run();
+	DoNotOptimize(sum);
+}
+
+void FanInThreadBench(BenchState& state) {
+	BlockingQueue<int64_t> queue(64);
+	const size_t producers = static_cast<size_t>(state.Arg());
+	std::vector<std::thread> threads;
+	for (size_t p = 0; p < producers; ++p) {
+		const size_t count = state.Iterations() / producers + (p < state.Iterations() % producers);
+		threads.emplace_back([&queue, count] {
+			for (size_t i = 0; i < count; ++i) {
+				queue.Push(static_cast<int64_t>(i));
+			}
+		});
+	}
+	int64_t sum = 0;
+	for (size_t i = 0; i < state.Iterations(); ++i) {
+		sum += queue.Pop();
+	}
+	for (size_t p = 0; p < producers; ++p) {
+		threads[p].join();
+	}
+	DoNotOptimize(sum);
+}
+
+const BenchRegistrar kPingPong("channel/ping_pong/Channel", &PingPongBench<ChannelMode::kSingleThreaded>, {0, 1});
+const BenchRegistrar kPingPongMt("channel/ping_pong/Channel<kMultiThreaded>", &PingPongBench<ChannelMode::kMultiThreaded>, {0, 1});
+const BenchRegistrar kPingPongQueued("channel/ping_pong/Channel+ResumeQueue", &PingPongQueuedBench, {0, 1});
+const BenchRegistrar kPingPongThread("channel/ping_pong/thread_queue", &PingPongThreadBench);
+const BenchRegistrar kFanIn("channel/fan_in/Channel+ResumeQueue", &FanInBench, {1, 4, 16});
+const BenchRegistrar kFanInThread("channel/fan_in/thread_queue", &FanInThreadBench, {1, 4, 16});
@@ -0,0 +1,562 @@
+// Containers and smart pointers against their standard counterparts. Each
+// pair of benchmarks shares one template so both sides run the same code.
+
+#include <any>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "any.h"
+#include "bench.h"
+#include "circular_buffer.h"
+#include "function.h"
+#include "shared_ptr.h"
+#include "unique_ptr.h"
+#include "variant.h"
+#include "vector.h"
+
+// Adapters giving both sides one interface.
+template <class T>
+struct StdVectorOps {
+	typedef std::vector<T> Type;
+	static void PushBack(Type& v, const T& value) {
+		v.push_back(value);
+	}
+	static size_t Size(const Type& v) {
+		return v.size();
+	}
+};
+
+template <class T>
+struct VectorOps {
+	typedef Vector<T> Type;
+	static void PushBack(Type& v, const T& value) {
+		v.PushBack(value);
+	}
+	static size_t Size(const Type& v) {
+		return v.Size();
+	}
+};
+
+template <class T>
+struct StdDequeOps {
+	typedef std::deque<T> Type;
+	static void PushBack(Type& q, const T& value) {
+		q.push_back(value);
+	}
+	static const T& Front(const Type& q) {
+		return q.front();
+	}
+	static void PopFront(Type& q) {
+		q.pop_front();
+	}
+	static size_t Size(const Type& q) {
+		return q.size();
+	}
+};
+
+template <class T>
+struct CircularBufferOps {
+	typedef CircularBuffer<T> Type;
+	static void PushBack(Type& q, const T& value) {
+		q.PushBack(value);
+	}
+	static T& Front(Type& q) {
+		return q.Front();
+	}
+	static void PopFront(Type& q) {
+		q.PopFront();
+	}
+	static size_t Size(const Type& q) {
+		return q.Size();
+	}
+};
+
+template <class T>
+T MakeValue(size_t i);
+
+template <>
+int MakeValue<int>(size_t i) {
+	return static_cast<int>(i);
+}
+
+template <>
+std::string MakeValue<std::string>(size_t i) {
+	return std::string(24, static_cast<char>('a' + i % 26));
+}
+
+// Growth from empty to Arg() elements.
+template <class Ops, class T>
+void PushBackBench(BenchState& state) {
+	const size_t count = static_cast<size_t>(state.Arg());
+	const T value = MakeValue<T>(7);
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		typename Ops::Type v;
+		for (size_t i = 0; i < count; ++i) {
+			Ops::PushBack(v, value);
+		}
+		DoNotOptimize(Ops::Size(v));
+	}
+}
+
+template <class Ops, class T>
+void IndexBench(BenchState& state) {
+	const size_t count = static_cast<size_t>(state.Arg());
+	typename Ops::Type v;
+	for (size_t i = 0; i < count; ++i) {
+		Ops::PushBack(v, MakeValue<T>(i));
+	}
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		size_t sum = 0;
+		for (size_t i = 0; i < count; ++i) {
+			sum += static_cast<size_t>(v[i]);
+		}
+		DoNotOptimize(sum);
+	}
+}
+
+template <class Ops, class T>
+void CopyBench(BenchState& state) {
+	const size_t count = static_cast<size_t>(state.Arg());
+	typename Ops::Type v;
+	for (size_t i = 0; i < count; ++i) {
+		Ops::PushBack(v, MakeValue<T>(i));
+	}
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		typename Ops::Type copy(v);
+		DoNotOptimize(Ops::Size(copy));
+	}
+}
+
+// Steady-state FIFO: push one, pop one, on a queue holding Arg() elements.
+template <class Ops, class T>
+void QueueBench(BenchState& state) {
+	const size_t count = static_cast<size_t>(state.Arg());
+	typename Ops::Type q;
+	const T value = MakeValue<T>(3);
+	for (size_t i = 0; i < count; ++i) {
+		Ops::PushBack(q, value);
+	}
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		Ops::PushBack(q, value);
+		Ops::PopFront(q);
+	}
+	DoNotOptimize(Ops::Size(q));
+}
+
+const BenchRegistrar kPushBackVectorInt("push_back/int/Vector", &PushBackBench<VectorOps<int>, int>, {16, 1024, 65536});
+const BenchRegistrar kPushBackStdInt("push_back/int/std::vector", &PushBackBench<StdVectorOps<int>, int>, {16, 1024, 65536});
+const BenchRegistrar kPushBackVectorStr("push_back/string/Vector", &PushBackBench<VectorOps<std::string>, std::string>, {16, 1024});
+const BenchRegistrar kPushBackStdStr("push_back/string/std::vector", &PushBackBench<StdVectorOps<std::string>, std::string>, {16, 1024});
+const BenchRegistrar kIndexVector("index/int/Vector", &IndexBench<VectorOps<int>, int>, {1024, 65536});
+const BenchRegistrar kIndexStd("index/int/std::vector", &IndexBench<StdVectorOps<int>, int>, {1024, 65536});
+const BenchRegistrar kIndexCircular("index/int/CircularBuffer", &IndexBench<CircularBufferOps<int>, int>, {1024, 65536});
+const BenchRegistrar kIndexDeque("index/int/std::deque", &IndexBench<StdDequeOps<int>, int>, {1024, 65536});
+const BenchRegistrar kCopyVectorInt("copy/int/Vector", &CopyBench<VectorOps<int>, int>, {1024, 65536});
+const BenchRegistrar kCopyStdInt("copy/int/std::vector", &CopyBench<StdVectorOps<int>, int>, {1024, 65536});
+const BenchRegistrar kCopyVectorStr("copy/string/Vector", &CopyBench<VectorOps<std::string>, std::string>, {1024});
+const BenchRegistrar kCopyStdStr("copy/string/std::vector", &CopyBench<StdVectorOps<std::string>, std::string>, {1024});
+const BenchRegistrar kCopyCircular("copy/int/CircularBuffer", &CopyBench<CircularBufferOps<int>, int>, {1024, 65536});
+const BenchRegistrar kCopyDeque("copy/int/std::deque", &CopyBench<StdDequeOps<int>, int>, {1024, 65536});
+const BenchRegistrar kQueueCircularInt("queue/int/CircularBuffer", &QueueBench<CircularBufferOps<int>, int>, {64, 4096});
+const BenchRegistrar kQueueDequeInt("queue/int/std::deque", &QueueBench<StdDequeOps<int>, int>, {64, 4096});
+const BenchRegistrar kQueueCircularStr("queue/string/CircularBuffer", &QueueBench<CircularBufferOps<std::string>, std::string>, {64});
+const BenchRegistrar kQueueDequeStr("queue/string/std::deque", &QueueBench<StdDequeOps<std::string>, std::string>, {64});
+
+// Market-data replay: a batch of Arg() 64-byte ticks goes through a queue that
+// already holds a few, so batches straddle the wrap point.
+struct Tick {
+	int64_t fields_[8];
+};
+
+const size_t kReplayBacklog = 100;
+
+static std::vector<Tick> MakeTicks(size_t count) {
+	std::vector<Tick> ticks(count);
+	for (size_t i = 0; i < count; ++i) {
+		ticks[i].fields_[0] = static_cast<int64_t>(i);
+	}
+	return ticks;
+}
+
+template <class Ops>
+void ReplayBench(BenchState& state) {
+	const std::vector<Tick> in = MakeTicks(static_cast<size_t>(state.Arg()));
+	std::vector<Tick> out(in.size());
+	typename Ops::Type q;
+	for (size_t i = 0; i < kReplayBacklog; ++i) {
+		Ops::PushBack(q, in[0]);
+	}
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		for (size_t i = 0; i < in.size(); ++i) {
+			Ops::PushBack(q, in[i]);
+		}
+		for (size_t i = 0; i < out.size(); ++i) {
+			out[i] = Ops::Front(q);
+			Ops::PopFront(q);
+		}
+		DoNotOptimize(out.data());
+	}
+}
+
+void ReplayBulkBench(BenchState& state) {
+	const std::vector<Tick> in = MakeTicks(static_cast<size_t>(state.Arg()));
+	std::vector<Tick> out(in.size());
+	CircularBuffer<Tick> q;
+	for (size_t i = 0; i < kReplayBacklog; ++i) {
+		q.PushBack(in[0]);
+	}
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		q.PushBackN(in.data(), in.size());
+		DoNotOptimize(q.PopFrontN(out.data(), out.size()));
+		DoNotOptimize(out.data());
+	}
+}
+
+// Sum of one field over a queue of Arg() ticks.
+void ScanForEachBench(BenchState& state) {
+	CircularBuffer<Tick> q;
+	const std::vector<Tick> in = MakeTicks(static_cast<size_t>(state.Arg()));
+	q.PushBackN(in.data(), in.size());
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		int64_t sum = 0;
+		q.ForEach([&sum](const Tick& tick) { sum += tick.fields_[0]; });
+		DoNotOptimize(sum);
+	}
+}
+
+void ScanDequeBench(BenchState& state) {
+	const std::vector<Tick> in = MakeTicks(static_cast<size_t>(state.Arg()));
+	std::deque<Tick> q(in.begin(), in.end());
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		int64_t sum = 0;
+		for (const Tick& tick : q) {
+			sum += tick.fields_[0];
+		}
+		DoNotOptimize(sum);
+	}
+}
+
+const BenchRegistrar kReplayBulk("replay/64B/CircularBuffer_bulk", &ReplayBulkBench, {64, 4096});
+const BenchRegistrar kReplayCircular("replay/64B/CircularBuffer", &ReplayBench<CircularBufferOps<Tick>>, {64, 4096});
+const BenchRegistrar kReplayDeque("replay/64B/std::deque", &ReplayBench<StdDequeOps<Tick>>, {64, 4096});
+const BenchRegistrar kScanForEach("scan/64B/CircularBuffer_ForEach", &ScanForEachBench, {1 << 16});
+const BenchRegistrar kScanDeque("scan/64B/std::deque", &ScanDequeBench, {1 << 16});
+
+struct Payload {
+	int64_t a_;
+	int64_t b_;
+};
+
+template <class Ptr>
+Ptr MakeSharedPayload();
+
+template <>
+SharedPtr<Payload> MakeSharedPayload<SharedPtr<Payload>>() {
+	return SharedPtr<Payload>(new Payload{1, 2});
+}
+
+template <>
+std::shared_ptr<Payload> MakeSharedPayload<std::shared_ptr<Payload>>() {
+	return std::shared_ptr<Payload>(new Payload{1, 2});
+}
+
+template <class Ptr>
+void SharedCreateBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		Ptr ptr = MakeSharedPayload<Ptr>();
+		DoNotOptimize(ptr);
+	}
+}
+
+// Reference count churn: copy and drop a pointer owned by this thread.
+template <class Ptr>
+void SharedCopyBench(BenchState& state) {
+	const Ptr ptr = MakeSharedPayload<Ptr>();
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		Ptr copy(ptr);
+		DoNotOptimize(copy);
+	}
+}
+
+// The same copy from a thread other than the one that created the object, so
+// the count goes through the atomic shared counter instead of the biased one.
+void SharedCopyNonOwnerBench(BenchState& state) {
+	SharedPtr<Payload> ptr;
+	std::thread owner([&ptr] {
+		ptr = MakeSharedPayload<SharedPtr<Payload>>();
+	});
+	owner.join();
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		SharedPtr<Payload> copy(ptr);
+		DoNotOptimize(copy);
+	}
+}
+
+const BenchRegistrar kSharedCreate("shared_ptr/create/SharedPtr", &SharedCreateBench<SharedPtr<Payload>>);
+const BenchRegistrar kSharedCreateStd("shared_ptr/create/std::shared_ptr", &SharedCreateBench<std::shared_ptr<Payload>>);
+const BenchRegistrar kSharedCopy("shared_ptr/copy/SharedPtr", &SharedCopyBench<SharedPtr<Payload>>);
+const BenchRegistrar kSharedCopyNonOwner("shared_ptr/copy/SharedPtr_non_owner", &SharedCopyNonOwnerBench);
+const BenchRegistrar kSharedCopyStd("shared_ptr/copy/std::shared_ptr", &SharedCopyBench<std::shared_ptr<Payload>>);
+
+void UniqueMoveBench(BenchState& state) {
+	UniquePtr<Payload> ptr = MakeUnique<Payload>();
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		UniquePtr<Payload> moved(std::move(ptr));
+		DoNotOptimize(moved);
+		ptr = std::move(moved);
+	}
+}
+
+void UniqueMoveStdBench(BenchState& state) {
+	std::unique_ptr<Payload> ptr = std::make_unique<Payload>();
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		std::unique_ptr<Payload> moved(std::move(ptr));
+		DoNotOptimize(moved);
+		ptr = std::move(moved);
+	}
+}
+
+void UniqueCreateBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		UniquePtr<Payload> ptr = MakeUnique<Payload>();
+		DoNotOptimize(ptr);
+	}
+}
+
+void UniqueCreateStdBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		std::unique_ptr<Payload> ptr = std::make_unique<Payload>();
+		DoNotOptimize(ptr);
+	}
+}
+
+const BenchRegistrar kUniqueMove("unique_ptr/move/UniquePtr", &UniqueMoveBench);
+const BenchRegistrar kUniqueMoveStd("unique_ptr/move/std::unique_ptr", &UniqueMoveStdBench);
+const BenchRegistrar kUniqueCreate("unique_ptr/create/UniquePtr", &UniqueCreateBench);
+const BenchRegistrar kUniqueCreateStd("unique_ptr/create/std::unique_ptr", &UniqueCreateStdBench);
+
+struct LargeValue {
+	int64_t values_[8];
+};
+
+template <class T>
+void AnyCastBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		Any value = T();
+		DoNotOptimize(AnyCast<T>(&value));
+	}
+}
+
+template <class T>
+void AnyCastStdBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		std::any value = T();
+		DoNotOptimize(std::any_cast<T>(&value));
+	}
+}
+
+// Copy of an existing value and destruction of the copy, the cost of passing
+// property bag entries around by value.
+template <class T>
+void AnyCopyBench(BenchState& state) {
+	const Any source = T();
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		Any copy(source);
+		DoNotOptimize(AnyCast<T>(&copy));
+	}
+}
+
+template <class T>
+void AnyCopyStdBench(BenchState& state) {
+	const std::any source = T();
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		std::any copy(source);
+		DoNotOptimize(std::any_cast<T>(&copy));
+	}
+}
+
+const BenchRegistrar kAnyInt("any/construct_cast/int/Any", &AnyCastBench<int>);
+const BenchRegistrar kAnyIntStd("any/construct_cast/int/std::any", &AnyCastStdBench<int>);
+const BenchRegistrar kAnyString("any/construct_cast/string/Any", &AnyCastBench<std::string>);
+const BenchRegistrar kAnyStringStd("any/construct_cast/string/std::any", &AnyCastStdBench<std::string>);
+const BenchRegistrar kAnyLarge("any/construct_cast/64B/Any", &AnyCastBench<LargeValue>);
+const BenchRegistrar kAnyLargeStd("any/construct_cast/64B/std::any", &AnyCastStdBench<LargeValue>);
+const BenchRegistrar kAnyCopyInt("any/copy_destroy/int/Any", &AnyCopyBench<int>);
+const BenchRegistrar kAnyCopyIntStd("any/copy_destroy/int/std::any", &AnyCopyStdBench<int>);
+const BenchRegistrar kAnyCopyDouble("any/copy_destroy/double/Any", &AnyCopyBench<double>);
+const BenchRegistrar kAnyCopyDoubleStd("any/copy_destroy/double/std::any", &AnyCopyStdBench<double>);
+const BenchRegistrar kAnyCopyPayload("any/copy_destroy/16B/Any", &AnyCopyBench<Payload>);
+const BenchRegistrar kAnyCopyPayloadStd("any/copy_destroy/16B/std::any", &AnyCopyStdBench<Payload>);
+const BenchRegistrar kAnyCopyLarge("any/copy_destroy/64B/Any", &AnyCopyBench<LargeValue>);
+const BenchRegistrar kAnyCopyLargeStd("any/copy_destroy/64B/std::any", &AnyCopyStdBench<LargeValue>);
+
+// Dispatch over a stream of mixed message payloads, in random order so that
+// branch prediction does not learn the sequence. One iteration handles one
+// message.
+struct TradeMsg {
+	int64_t price_;
+	int64_t quantity_;
+};
+
+struct QuoteMsg {
+	int64_t bid_;
+	int64_t ask_;
+};
+
+struct HeartbeatMsg {
+	int64_t sequence_;
+};
+
+struct MessageHandler {
+	int64_t operator()(const TradeMsg& msg) const {
+		return msg.price_ * msg.quantity_;
+	}
+	int64_t operator()(const QuoteMsg& msg) const {
+		return msg.ask_ - msg.bid_;
+	}
+	int64_t operator()(const HeartbeatMsg& msg) const {
+		return msg.sequence_;
+	}
+	int64_t operator()(const std::string& msg) const {
+		return static_cast<int64_t>(msg.size());
+	}
+};
+
+const size_t kMessages = 4096;
+
+template <class Message>
+static std::vector<Message> MakeMessages() {
+	std::vector<Message> messages;
+	uint64_t state = 88172645463325252ULL;
+	for (size_t i = 0; i < kMessages; ++i) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		const int64_t x = static_cast<int64_t>(i);
+		switch (state % 4) {
+		case 0:
+			messages.push_back(Message(TradeMsg{x, 2}));
+			break;
+		case 1:
+			messages.push_back(Message(QuoteMsg{x, x + 1}));
+			break;
+		case 2:
+			messages.push_back(Message(HeartbeatMsg{x}));
+			break;
+		default:
+			messages.push_back(Message(std::string(20, 'm')));
+			break;
+		}
+	}
+	return messages;
+}
+
+typedef Variant<TradeMsg, QuoteMsg, HeartbeatMsg, std::string> MessageVariant;
+
+void VariantVisitBench(BenchState& state) {
+	const std::vector<MessageVariant> messages = MakeMessages<MessageVariant>();
+	int64_t sum = 0;
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		sum += Visit(MessageHandler(), messages[it % kMessages]);
+	}
+	DoNotOptimize(sum);
+}
+
+void AnyCastChainBench(BenchState& state) {
+	const std::vector<Any> messages = MakeMessages<Any>();
+	const MessageHandler handler;
+	int64_t sum = 0;
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		const Any& msg = messages[it % kMessages];
+		if (const TradeMsg* trade = AnyCast<TradeMsg>(&msg)) {
+			sum += handler(*trade);
+		} else if (const QuoteMsg* quote = AnyCast<QuoteMsg>(&msg)) {
+			sum += handler(*quote);
+		} else if (const HeartbeatMsg* heartbeat = AnyCast<HeartbeatMsg>(&msg)) {
+			sum += handler(*heartbeat);
+		} else if (const std::string* text = AnyCast<std::string>(&msg)) {
+			sum += handler(*text);
+		}
+	}
+	DoNotOptimize(sum);
+}
+
+const BenchRegistrar kVariantVisit("dispatch/mixed/Variant_Visit", &VariantVisitBench);
+const BenchRegistrar kAnyCastChain("dispatch/mixed/Any_AnyCast_chain", &AnyCastChainBench);
+
+template <class Fn>
+void FunctionCallBench(BenchState& state) {
+	int64_t captured = 3;
+	Fn fn = [captured](int64_t x) { return x + captured; };
+	int64_t sum = 0;
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		DoNotOptimize(fn);
+		sum += fn(static_cast<int64_t>(it));
+	}
+	DoNotOptimize(sum);
+}
+
+const BenchRegistrar kFunctionCall("function/call/Function", &FunctionCallBench<Function<int64_t(int64_t)>>);
+const BenchRegistrar kFunctionCallStd("function/call/std::function", &FunctionCallBench<std::function<int64_t(int64_t)>>);
+
+// Task queue: callbacks with non-trivial captures are pushed into a
+// CircularBuffer and run in batches of kTaskBatch, as an event loop does. One
+// iteration enqueues and later invokes one task. The small task captures a
+// SharedPtr and a pointer (24 bytes), the large one a short std::string and
+// a pointer (40 bytes); std::function stores neither inline.
+const size_t kTaskBatch = 64;
+
+struct SmallTask {
+	SharedPtr<Payload> payload_;
+	int64_t* sink_;
+
+	void operator()() const {
+		*sink_ += payload_->a_;
+	}
+};
+
+struct LargeTask {
+	std::string name_;
+	int64_t* sink_;
+
+	void operator()() const {
+		*sink_ += static_cast<int64_t>(name_.size());
+	}
+};
+
+template <class Fn>
+static void RunTasks(CircularBuffer<Fn>& queue) {
+	while (!queue.Empty()) {
+		Fn task = std::move(queue.Front());
+		queue.PopFront();
+		task();
+	}
+}
+
+template <class Fn, class Task>
+void TaskQueueBench(BenchState& state) {
+	CircularBuffer<Fn> queue(kTaskBatch);
+	int64_t sink = 0;
+	const SharedPtr<Payload> payload = MakeSharedPayload<SharedPtr<Payload>>();
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		if constexpr (std::is_same<Task, SmallTask>::value) {
+			queue.PushBack(Fn(SmallTask{payload, &sink}));
+		} else {
+			queue.PushBack(Fn(LargeTask{std::string(12, 't'), &sink}));
+		}
+		if (queue.Size() == kTaskBatch) {
+			RunTasks(queue);
+		}
+	}
+	RunTasks(queue);
+	DoNotOptimize(sink);
+}
+
+const BenchRegistrar kTaskSmallUnique("task_queue/24B/UniqueFunction", &TaskQueueBench<UniqueFunction<void()>, SmallTask>);
+const BenchRegistrar kTaskSmallStd("task_queue/24B/std::function", &TaskQueueBench<std::function<void()>, SmallTask>);
+const BenchRegistrar kTaskLargeUnique("task_queue/40B/UniqueFunction<48>", &TaskQueueBench<UniqueFunction<void(), 48>, LargeTask>);
+const BenchRegistrar kTaskLargeStd("task_queue/40B/std::function", &TaskQueueBench<std::function<void()>, LargeTask>);
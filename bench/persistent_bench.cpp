@@ -0,0 +1,95 @@
+// PersistentVector snapshots against copying a Vector, and the cost of
+// appends, updates and reads relative to Vector.
+
+#include <cstdint>
+#include <map>
+#include "bench.h"
+#include "persistent_vector.h"
+#include "vector.h"
+
+template <class V>
+static V MakeFilled(size_t count) {
+	V v;
+	for (size_t i = 0; i < count; ++i) {
+		v.PushBack(static_cast<int64_t>(i));
+	}
+	return v;
+}
+
+// Filled once per size and reused across runs, so that building 10M elements
+// is not part of the measurement.
+template <class V>
+static V& Filled(size_t count) {
+	static std::map<size_t, V> cache;
+	auto it = cache.find(count);
+	if (it == cache.end()) {
+		it = cache.emplace(count, MakeFilled<V>(count)).first;
+	}
+	return it->second;
+}
+
+// One iteration takes a snapshot and then updates one element, which is what
+// a writer that publishes after every change pays.
+static void SnapshotBench(BenchState& state) {
+	PersistentVector<int64_t>& v = Filled<PersistentVector<int64_t>>(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		PersistentVector<int64_t> snapshot = v.Snapshot();
+		DoNotOptimize(snapshot);
+		v.Set(it % v.Size(), static_cast<int64_t>(it));
+	}
+}
+
+static void VectorCopyBench(BenchState& state) {
+	Vector<int64_t>& v = Filled<Vector<int64_t>>(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		Vector<int64_t> copy(v);
+		DoNotOptimize(copy.Data());
+		v[it % v.Size()] = static_cast<int64_t>(it);
+	}
+}
+
+template <class V>
+static void AppendBench(BenchState& state) {
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		V v = MakeFilled<V>(static_cast<size_t>(state.Arg()));
+		DoNotOptimize(v.Size());
+	}
+}
+
+static void PersistentSetBench(BenchState& state) {
+	PersistentVector<int64_t> v = MakeFilled<PersistentVector<int64_t>>(static_cast<size_t>(state.Arg()));
+	size_t idx = 0;
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		v.Set(idx, static_cast<int64_t>(it));
+		idx = (idx + 7919) % v.Size();
+	}
+	DoNotOptimize(v.Size());
+}
+
+static void PersistentIterateBench(BenchState& state) {
+	const PersistentVector<int64_t> v = MakeFilled<PersistentVector<int64_t>>(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		int64_t sum = 0;
+		v.ForEach([&sum](int64_t x) { sum += x; });
+		DoNotOptimize(sum);
+	}
+}
+
+static void VectorIterateBench(BenchState& state) {
+	Vector<int64_t> v = MakeFilled<Vector<int64_t>>(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		int64_t sum = 0;
+		for (size_t i = 0; i < v.Size(); ++i) {
+			sum += v[i];
+		}
+		DoNotOptimize(sum);
+	}
+}
+
+const BenchRegistrar kSnapshot("persistent/snapshot_and_set/PersistentVector", &SnapshotBench, {1 << 10, 1 << 20, 10000000});
+const BenchRegistrar kVectorCopy("persistent/snapshot_and_set/Vector_copy", &VectorCopyBench, {1 << 10, 1 << 20, 10000000});
+const BenchRegistrar kAppend("persistent/append/PersistentVector", &AppendBench<PersistentVector<int64_t>>, {1024, 65536});
+const BenchRegistrar kAppendVector("persistent/append/Vector", &AppendBench<Vector<int64_t>>, {1024, 65536});
+const BenchRegistrar kSet("persistent/set/PersistentVector", &PersistentSetBench, {1 << 20});
+const BenchRegistrar kIterate("persistent/iterate/PersistentVector", &PersistentIterateBench, {1 << 20});
+const BenchRegistrar kIterateVector("persistent/iterate/Vector", &VectorIterateBench, {1 << 20});
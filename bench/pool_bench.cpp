@@ -0,0 +1,65 @@
+// ThreadPool scaling: recursive fork-join and uniform/skewed parallel loops.
+// The argument is the number of workers; one iteration is one whole run.
+
+#include <atomic>
+#include <cstdint>
+#include "bench.h"
+#include "thread_pool.h"
+
+static int64_t SerialFib(int n) {
+	return n < 2 ? n : SerialFib(n - 1) + SerialFib(n - 2);
+}
+
+static int64_t Fib(ThreadPool& pool, int n) {
+	if (n < 18) {
+		return SerialFib(n);
+	}
+	int64_t a = 0;
+	TaskGroup group(pool);
+	group.Run([&pool, &a, n] { a = Fib(pool, n - 1); });
+	const int64_t b = Fib(pool, n - 2);
+	group.Wait();
+	return a + b;
+}
+
+static void FibBench(BenchState& state) {
+	ThreadPool pool(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		int64_t result = 0;
+		pool.Submit([&pool, &result] { result = Fib(pool, 30); }).Wait();
+		DoNotOptimize(result);
+	}
+}
+
+static uint64_t Work(size_t i, size_t rounds) {
+	uint64_t x = i;
+	for (size_t k = 0; k < rounds; ++k) {
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+	}
+	return x;
+}
+
+static void UniformLoopBench(BenchState& state) {
+	ThreadPool pool(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		std::atomic<uint64_t> sum(0);
+		pool.ParallelFor(0, 1 << 16, [&sum](size_t i) { sum.fetch_add(Work(i, 64), std::memory_order_relaxed); });
+		DoNotOptimize(sum.load());
+	}
+}
+
+// The first 1/16 of the iterations cost 256 times as much as the rest.
+static void SkewedLoopBench(BenchState& state) {
+	ThreadPool pool(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		std::atomic<uint64_t> sum(0);
+		pool.ParallelFor(0, 1 << 16, [&sum](size_t i) {
+			sum.fetch_add(Work(i, i < (1 << 12) ? 1024 : 4), std::memory_order_relaxed);
+		});
+		DoNotOptimize(sum.load());
+	}
+}
+
+const BenchRegistrar kFib("pool/fib30", &FibBench, {1, 2, 4, 8, 16, 32, 64});
+const BenchRegistrar kUniform("pool/parallel_for/uniform", &UniformLoopBench, {1, 2, 4, 8, 16, 32, 64});
+const BenchRegistrar kSkewed("pool/parallel_for/skewed", &SkewedLoopBench, {1, 2, 4, 8, 16, 32, 64});
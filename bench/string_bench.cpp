@@ -0,0 +1,244 @@
+// StringView against std::string_view on substring, search and comparison,
+// and CSV parsing with the lazy splitters against std::getline.
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/stat.h>
+#include "bench.h"
+#include "mapped_file.h"
+#include "string_split.h"
+#include "string_view.h"
+
+static std::string MakeText(size_t size) {
+	std::string text;
+	text.reserve(size);
+	for (size_t i = 0; text.size() < size; ++i) {
+		text += "lorem ipsum dolor sit amet ";
+		text += std::to_string(i);
+		text += '\n';
+	}
+	text.resize(size);
+	return text;
+}
+
+template <class View>
+View MakeView(const std::string& text) {
+	return View(text.data(), text.size());
+}
+
+size_t ViewSize(StringView view) {
+	return view.Size();
+}
+
+size_t ViewSize(std::string_view view) {
+	return view.size();
+}
+
+size_t FindIn(StringView view, char c, size_t pos) {
+	return view.Find(c, pos);
+}
+
+size_t FindIn(std::string_view view, char c, size_t pos) {
+	return view.find(c, pos);
+}
+
+size_t FindIn(StringView view, StringView needle) {
+	return view.Find(needle);
+}
+
+size_t FindIn(std::string_view view, std::string_view needle) {
+	return view.find(needle);
+}
+
+StringView SubstrOf(StringView view, size_t pos, size_t count) {
+	return view.Substr(pos, count);
+}
+
+std::string_view SubstrOf(std::string_view view, size_t pos, size_t count) {
+	return view.substr(pos, count);
+}
+
+// Slices of 16 bytes across the text, as a tokenizer would take them.
+template <class View>
+void SubstrBench(BenchState& state) {
+	const std::string text = MakeText(static_cast<size_t>(state.Arg()));
+	const View view = MakeView<View>(text);
+	size_t pos = 0;
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		const View sub = SubstrOf(view, pos, 16);
+		DoNotOptimize(sub);
+		pos = pos + 16 < ViewSize(view) ? pos + 16 : 0;
+	}
+}
+
+// Walks all newlines of the text.
+template <class View>
+void FindCharBench(BenchState& state) {
+	const std::string text = MakeText(static_cast<size_t>(state.Arg()));
+	const View view = MakeView<View>(text);
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		size_t count = 0;
+		for (size_t pos = FindIn(view, '\n', 0); pos != std::string::npos; pos = FindIn(view, '\n', pos + 1)) {
+			++count;
+		}
+		DoNotOptimize(count);
+	}
+}
+
+template <class View>
+void FindStringBench(BenchState& state) {
+	const std::string text = MakeText(static_cast<size_t>(state.Arg())) + "needle in the haystack";
+	const View view = MakeView<View>(text);
+	const View needle("needle in the");
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		DoNotOptimize(FindIn(view, needle));
+	}
+}
+
+template <class View>
+void CompareBench(BenchState& state) {
+	const std::string a = MakeText(static_cast<size_t>(state.Arg()));
+	std::string b = a;
+	b.back() = '!';
+	const View lhs = MakeView<View>(a);
+	const View rhs = MakeView<View>(b);
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		DoNotOptimize(lhs == rhs);
+		DoNotOptimize(lhs < rhs);
+	}
+}
+
+const BenchRegistrar kSubstr("string_view/substr/StringView", &SubstrBench<StringView>, {4096, 1 << 20});
+const BenchRegistrar kSubstrStd("string_view/substr/std::string_view", &SubstrBench<std::string_view>, {4096, 1 << 20});
+const BenchRegistrar kFindChar("string_view/find_char/StringView", &FindCharBench<StringView>, {4096, 1 << 20});
+const BenchRegistrar kFindCharStd("string_view/find_char/std::string_view", &FindCharBench<std::string_view>, {4096, 1 << 20});
+const BenchRegistrar kFindString("string_view/find_string/StringView", &FindStringBench<StringView>, {4096, 1 << 20});
+const BenchRegistrar kFindStringStd("string_view/find_string/std::string_view", &FindStringBench<std::string_view>, {4096, 1 << 20});
+const BenchRegistrar kCompare("string_view/compare/StringView", &CompareBench<StringView>, {64, 4096});
+const BenchRegistrar kCompareStd("string_view/compare/std::string_view", &CompareBench<std::string_view>, {64, 4096});
+
+// Trade records of about 38 bytes in Arg() MiB, written to $TMPDIR (or /tmp)
+// on first use and kept there for later runs.
+static std::string CsvPath(size_t mib) {
+	const char* dir = std::getenv("TMPDIR");
+	return std::string(dir != nullptr ? dir : "/tmp") + "/bench_trades_" + std::to_string(mib) + "MiB.csv";
+}
+
+static std::string MakeCsv(size_t mib) {
+	const std::string path = CsvPath(mib);
+	const size_t size = mib << 20;
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0 && static_cast<size_t>(st.st_size) >= size) {
+		return path;
+	}
+	static const char* const kSymbols[] = {"AAPL", "MSFT", "GOOG", "AMZN", "NVDA", "META", "TSLA", "BRK.B"};
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	std::string block;
+	size_t written = 0;
+	for (uint64_t i = 0; written < size; ++i) {
+		block += std::to_string(1700000000000 + i * 37);
+		block += ',';
+		block += kSymbols[i % 8];
+		block += ',';
+		block += std::to_string(100 + i % 900);
+		block += '.';
+		block += std::to_string(10 + i % 90);
+		block += ',';
+		block += std::to_string(1 + i % 5000);
+		block += i % 2 == 0 ? ",B,XNAS\n" : ",S,ARCX\n";
+		if (block.size() >= (1 << 20)) {
+			out.write(block.data(), static_cast<std::streamsize>(block.size()));
+			written += block.size();
+			block.clear();
+		}
+	}
+	return path;
+}
+
+// One iteration parses the whole file: every line is split into fields and the
+// field count and total field length are accumulated.
+static void CsvSplitBench(BenchState& state) {
+	const std::string path = MakeCsv(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		MappedFile file(path.c_str());
+		size_t fields = 0;
+		size_t bytes = 0;
+		for (StringView line : Lines(file.View())) {
+			for (StringView field : Split(line, ',')) {
+				++fields;
+				bytes += field.Size();
+			}
+		}
+		DoNotOptimize(fields);
+		DoNotOptimize(bytes);
+	}
+}
+
+// Fields are assigned into the row's existing strings, so once the row has
+// grown the loop copies bytes but does not allocate.
+static void CsvGetlineBench(BenchState& state) {
+	const std::string path = MakeCsv(static_cast<size_t>(state.Arg()));
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		std::ifstream file(path, std::ios::binary);
+		std::string line;
+		std::vector<std::string> row;
+		size_t fields = 0;
+		size_t bytes = 0;
+		while (std::getline(file, line)) {
+			size_t count = 0;
+			size_t start = 0;
+			for (;;) {
+				const size_t comma = line.find(',', start);
+				const size_t size = comma == std::string::npos ? std::string::npos : comma - start;
+				if (count == row.size()) {
+					row.emplace_back();
+				}
+				row[count++].assign(line, start, size);
+				if (comma == std::string::npos) {
+					break;
+				}
+				start = comma + 1;
+			}
+			for (size_t i = 0; i < count; ++i) {
+				++fields;
+				bytes += row[i].size();
+			}
+		}
+		DoNotOptimize(fields);
+		DoNotOptimize(bytes);
+	}
+}
+
+struct CsvTotals {
+	size_t fields_;
+	size_t bytes_;
+};
+
+// The same parse of the 1 GiB file through ForEachLineChunked on Arg()
+// threads; Arg() 1 runs the serial loop on the calling thread.
+static void CsvChunkedBench(BenchState& state) {
+	const std::string path = MakeCsv(1024);
+	const size_t threads = static_cast<size_t>(state.Arg());
+	for (size_t it = 0; it < state.Iterations(); ++it) {
+		MappedFile file(path.c_str());
+		const CsvTotals totals = ForEachLineChunked(
+			file.View(), CsvTotals{0, 0},
+			[](CsvTotals& acc, StringView line) {
+				for (StringView field : Split(line, ',')) {
+					++acc.fields_;
+					acc.bytes_ += field.Size();
+				}
+			},
+			[](CsvTotals lhs, CsvTotals rhs) { return CsvTotals{lhs.fields_ + rhs.fields_, lhs.bytes_ + rhs.bytes_}; },
+			threads);
+		DoNotOptimize(totals);
+	}
+}
+
+const BenchRegistrar kCsvSplit("csv/parse/MappedFile_Lines_Split", &CsvSplitBench, {1024});
+const BenchRegistrar kCsvGetline("csv/parse/std::getline_string", &CsvGetlineBench, {1024});
+const BenchRegistrar kCsvChunked("csv/parse/ForEachLineChunked_1GiB", &CsvChunkedBench, {1, 2, 4, 8, 16});
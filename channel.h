@@ -0,0 +1,423 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+// Requires C++20 (coroutines).
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "circular_buffer.h"
+#include "function.h"
+
+enum class ChannelMode {
+	kSingleThreaded,
+	kMultiThreaded
+};
+
+// Stands in for std::mutex in single-threaded channels.
+struct NullMutex {
+	void lock() {
+	}
+	void unlock() {
+	}
+};
+
+// Channel between coroutines, buffered in a CircularBuffer:
+//
+//   Channel<int> ch(16);
+//   bool sent = co_await ch.Send(1);             // false once closed
+//   std::optional<int> v = co_await ch.Receive(); // empty once closed and drained
+//
+// Send suspends while the channel is full and Receive while it is empty;
+// capacity 0 makes every Send wait for a receiver. A value sent while
+// receivers are waiting goes straight to the oldest of them.
+//
+// Suspended coroutines are kept in intrusive lists threaded through their
+// awaiters, so waiting does not allocate. Coroutines woken by an operation
+// are collected while the channel is locked and resumed as one batch after it
+// is unlocked, through the executor if one was given, e.g.
+// [&pool](std::coroutine_handle<> h) { pool.Submit([h] { h.resume(); }); },
+// and inline otherwise. kSingleThreaded channels take no locks and must only
+// be used from one thread at a time; kMultiThreaded ones hold a mutex only
+// while moving values and waiters around.
+//
+// Values are only ever moved, so move-only T such as std::unique_ptr works;
+// T must be default-constructible for the buffer's storage.
+template <class T, ChannelMode Mode = ChannelMode::kSingleThreaded>
+class Channel {
+public:
+	typedef Function<void(std::coroutine_handle<>)> Executor;
+	const static size_t kUnbounded = SIZE_MAX;
+
+	class SendAwaiter;
+	class ReceiveAwaiter;
+
+private:
+	struct Waiter {
+		std::coroutine_handle<> handle_;
+		Waiter* next_ = nullptr;
+	};
+
+	struct WaiterList {
+		Waiter* head_ = nullptr;
+		Waiter* tail_ = nullptr;
+
+		bool Empty() const;
+		void Push(Waiter* waiter);
+		Waiter* Pop();
+	};
+
+	typedef std::conditional_t<Mode == ChannelMode::kMultiThreaded, std::mutex, NullMutex> Mutex;
+
+	mutable Mutex mutex_;
+	CircularBuffer<T> buffer_;
+	size_t capacity_;
+	bool closed_;
+	WaiterList senders_;
+	WaiterList receivers_;
+	Executor executor_;
+
+	bool TrySendLocked(T& value, WaiterList& ready);
+	bool TryReceiveLocked(std::optional<T>& slot, WaiterList& ready);
+	void Resume(WaiterList& ready);
+
+public:
+	class SendAwaiter : Waiter {
+		friend class Channel;
+		Channel* channel_;
+		T value_;
+		bool ok_;
+
+		SendAwaiter(Channel* channel, T&& value);
+
+	public:
+		bool await_ready();
+		bool await_suspend(std::coroutine_handle<> handle);
+		bool await_resume() const;
+	};
+
+	class ReceiveAwaiter : Waiter {
+		friend class Channel;
+		Channel* channel_;
+		std::optional<T> slot_;
+
+		explicit ReceiveAwaiter(Channel* channel);
+
+	public:
+		bool await_ready();
+		bool await_suspend(std::coroutine_handle<> handle);
+		std::optional<T> await_resume();
+	};
+
+	explicit Channel(size_t capacity = kUnbounded, Executor executor = nullptr);
+	Channel(const Channel&) = delete;
+	Channel& operator=(const Channel&) = delete;
+
+	SendAwaiter Send(T value);
+	ReceiveAwaiter Receive();
+	bool TrySend(T value);
+	std::optional<T> TryReceive();
+	void Close();
+	bool Closed() const;
+	size_t Size() const;
+	size_t Capacity() const;
+};
+
+// FIFO of coroutines to resume, for driving single-threaded channels from a
+// loop instead of resuming waiters inside the operation that woke them:
+//
+//   ResumeQueue queue;
+//   Channel<int> ch(16, [&queue](std::coroutine_handle<> h) { queue.Post(h); });
+//   ... start coroutines ...
+//   queue.Run();
+class ResumeQueue {
+	CircularBuffer<std::coroutine_handle<>> queue_;
+
+public:
+	void Post(std::coroutine_handle<> handle);
+	size_t Run();
+	bool Empty() const;
+};
+
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::WaiterList::Empty() const {
+	return head_ == nullptr;
+}
+
+template <class T, ChannelMode Mode>
+void Channel<T, Mode>::WaiterList::Push(Waiter* waiter) {
+	waiter->next_ = nullptr;
+	if (tail_ == nullptr) {
+		head_ = waiter;
+	} else {
+		tail_->next_ = waiter;
+	}
+	tail_ = waiter;
+}
+
+template <class T, ChannelMode Mode>
+typename Channel<T, Mode>::Waiter* Channel<T, Mode>::WaiterList::Pop() {
+	Waiter* waiter = head_;
+	head_ = waiter->next_;
+	if (head_ == nullptr) {
+		tail_ = nullptr;
+	}
+	return waiter;
+}
+
+// Hands the value to the oldest waiting receiver, or buffers it if there is
+// room. Receivers only wait while the buffer is empty.
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::TrySendLocked(T& value, WaiterList& ready) {
+	if (!receivers_.Empty()) {
+		ReceiveAwaiter* receiver = static_cast<ReceiveAwaiter*>(receivers_.Pop());
+		receiver->slot_.emplace(std::move(value));
+		ready.Push(receiver);
+		return true;
+	}
+	if (buffer_.Size() < capacity_) {
+		buffer_.PushBack(std::move(value));
+		return true;
+	}
+	return false;
+}
+
+// Takes the oldest value; the slot it frees goes to the oldest waiting
+// sender. Unbuffered channels take the value from the sender directly. Once
+// the channel is closed and drained this succeeds with an empty slot.
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::TryReceiveLocked(std::optional<T>& slot, WaiterList& ready) {
+	if (!buffer_.Empty()) {
+		slot.emplace(std::move(buffer_.Front()));
+		buffer_.PopFront();
+		if (!senders_.Empty()) {
+			SendAwaiter* sender = static_cast<SendAwaiter*>(senders_.Pop());
+			buffer_.PushBack(std::move(sender->value_));
+			sender->ok_ = true;
+			ready.Push(sender);
+		}
+		return true;
+	}
+	if (!senders_.Empty()) {
+		SendAwaiter* sender = static_cast<SendAwaiter*>(senders_.Pop());
+		slot.emplace(std::move(sender->value_));
+		sender->ok_ = true;
+		ready.Push(sender);
+		return true;
+	}
+	return closed_;
+}
+
+template <class T, ChannelMode Mode>
+void Channel<T, Mode>::Resume(WaiterList& ready) {
+	Waiter* waiter = ready.head_;
+	while (waiter != nullptr) {
+		// The awaiter lives in the frame of the coroutine being resumed.
+		Waiter* next = waiter->next_;
+		if (executor_) {
+			executor_(waiter->handle_);
+		} else {
+			waiter->handle_.resume();
+		}
+		waiter = next;
+	}
+}
+
+template <class T, ChannelMode Mode>
+Channel<T, Mode>::SendAwaiter::SendAwaiter(Channel* channel, T&& value) :
+channel_(channel), value_(std::move(value)), ok_(true) {
+}
+
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::SendAwaiter::await_ready() {
+	WaiterList ready;
+	{
+		std::lock_guard<Mutex> lock(channel_->mutex_);
+		if (channel_->closed_) {
+			ok_ = false;
+			return true;
+		}
+		if (!channel_->TrySendLocked(value_, ready)) {
+			return false;
+		}
+	}
+	channel_->Resume(ready);
+	return true;
+}
+
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::SendAwaiter::await_suspend(std::coroutine_handle<> handle) {
+	std::unique_lock<Mutex> lock(channel_->mutex_);
+	// Without other threads nothing can have changed since await_ready.
+	if constexpr (Mode == ChannelMode::kMultiThreaded) {
+		WaiterList ready;
+		if (channel_->closed_) {
+			ok_ = false;
+			return false;
+		}
+		if (channel_->TrySendLocked(value_, ready)) {
+			lock.unlock();
+			channel_->Resume(ready);
+			return false;
+		}
+	}
+	// Once queued, another thread may resume the coroutine at any moment, so
+	// nothing may touch the awaiter after the push.
+	this->handle_ = handle;
+	channel_->senders_.Push(this);
+	return true;
+}
+
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::SendAwaiter::await_resume() const {
+	return ok_;
+}
+
+template <class T, ChannelMode Mode>
+Channel<T, Mode>::ReceiveAwaiter::ReceiveAwaiter(Channel* channel) : channel_(channel) {
+}
+
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::ReceiveAwaiter::await_ready() {
+	WaiterList ready;
+	{
+		std::lock_guard<Mutex> lock(channel_->mutex_);
+		if (!channel_->TryReceiveLocked(slot_, ready)) {
+			return false;
+		}
+	}
+	channel_->Resume(ready);
+	return true;
+}
+
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::ReceiveAwaiter::await_suspend(std::coroutine_handle<> handle) {
+	std::unique_lock<Mutex> lock(channel_->mutex_);
+	if constexpr (Mode == ChannelMode::kMultiThreaded) {
+		WaiterList ready;
+		if (channel_->TryReceiveLocked(slot_, ready)) {
+			lock.unlock();
+			channel_->Resume(ready);
+			return false;
+		}
+	}
+	this->handle_ = handle;
+	channel_->receivers_.Push(this);
+	return true;
+}
+
+template <class T, ChannelMode Mode>
+std::optional<T> Channel<T, Mode>::ReceiveAwaiter::await_resume() {
+	return std::move(slot_);
+}
+
+template <class T, ChannelMode Mode>
+Channel<T, Mode>::Channel(size_t capacity, Executor executor) :
+capacity_(capacity), closed_(false), executor_(std::move(executor)) {
+}
+
+template <class T, ChannelMode Mode>
+typename Channel<T, Mode>::SendAwaiter Channel<T, Mode>::Send(T value) {
+	return SendAwaiter(this, std::move(value));
+}
+
+template <class T, ChannelMode Mode>
+typename Channel<T, Mode>::ReceiveAwaiter Channel<T, Mode>::Receive() {
+	return ReceiveAwaiter(this);
+}
+
+// Sends without waiting, for producers that are not coroutines. Fails if the
+// channel is closed or full.
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::TrySend(T value) {
+	WaiterList ready;
+	{
+		std::lock_guard<Mutex> lock(mutex_);
+		if (closed_ || !TrySendLocked(value, ready)) {
+			return false;
+		}
+	}
+	Resume(ready);
+	return true;
+}
+
+template <class T, ChannelMode Mode>
+std::optional<T> Channel<T, Mode>::TryReceive() {
+	WaiterList ready;
+	std::optional<T> slot;
+	{
+		std::lock_guard<Mutex> lock(mutex_);
+		if (!TryReceiveLocked(slot, ready)) {
+			return std::nullopt;
+		}
+	}
+	Resume(ready);
+	return slot;
+}
+
+// Wakes every waiter: senders get false, receivers get the values still
+// buffered and then an empty optional.
+template <class T, ChannelMode Mode>
+void Channel<T, Mode>::Close() {
+	WaiterList ready;
+	{
+		std::lock_guard<Mutex> lock(mutex_);
+		if (closed_) {
+			return;
+		}
+		closed_ = true;
+		while (!receivers_.Empty()) {
+			ready.Push(receivers_.Pop());
+		}
+		while (!senders_.Empty()) {
+			SendAwaiter* sender = static_cast<SendAwaiter*>(senders_.Pop());
+			sender->ok_ = false;
+			ready.Push(sender);
+		}
+	}
+	Resume(ready);
+}
+
+template <class T, ChannelMode Mode>
+bool Channel<T, Mode>::Closed() const {
+	std::lock_guard<Mutex> lock(mutex_);
+	return closed_;
+}
+
+template <class T, ChannelMode Mode>
+size_t Channel<T, Mode>::Size() const {
+	std::lock_guard<Mutex> lock(mutex_);
+	return buffer_.Size();
+}
+
+template <class T, ChannelMode Mode>
+size_t Channel<T, Mode>::Capacity() const {
+	return capacity_;
+}
+
+inline void ResumeQueue::Post(std::coroutine_handle<> handle) {
+	queue_.PushBack(handle);
+}
+
+// Resumes queued coroutines, including ones queued meanwhile, until none are
+// left. Returns how many were resumed.
+inline size_t ResumeQueue::Run() {
+	size_t count = 0;
+	while (!queue_.Empty()) {
+		const std::coroutine_handle<> handle = queue_.Front();
+		queue_.PopFront();
+		handle.resume();
+		++count;
+	}
+	return count;
+}
+
+inline bool ResumeQueue::Empty() const {
+	return queue_.Empty();
+}
+
+#endif
@@ -1,22 +1,47 @@
 #ifndef CIRCULARBUFFER_H
 #define CIRCULARBUFFER_H
 #include <cstddef>
-
+#include <type_traits>
+#include <utility>
+#include "container_utils.h"
+#include "memory_resource.h"
+
+// Ring buffer with a power-of-two capacity, so that positions wrap with a
+// mask. The contents occupy at most two contiguous segments of the storage,
+// [front_, capacity_) and [0, rest), and realignment, copies and the bulk
+// PushBackN/PopFrontN move whole segments, with memcpy for trivially
+// copyable T. For elements of a cache line or more, such as 64-byte records,
+// storage is aligned to cache lines so that no element straddles two; smaller
+// elements keep the allocator's alignment, which is cheaper to allocate.
+//
+// T must be default-constructible, since the storage is, and move-assignable;
+// growing moves the elements, so move-only types work. Copying the buffer and
+// the const& pushes also need T to be copy-assignable.
 template <class T>
 class CircularBuffer {
+	static_assert(std::is_default_constructible<T>::value, "CircularBuffer requires a default-constructible T");
+	static_assert(std::is_move_assignable<T>::value, "CircularBuffer requires a move-assignable T");
+
 	size_t capacity_;
 	size_t size_;
 	size_t front_;
-	size_t back_;
 	T* buf_;
+	MemoryResource* resource_;
 	const static size_t kIncreaseFactor = 2;
+	const static size_t kAlign = sizeof(T) >= 64 && alignof(T) < 64 ? 64 : alignof(T);
+	const static size_t kPrefetchBytes = 256;
 
+	size_t Position(size_t idx) const;
+	void CopyOut(T* to) const;
+	void MoveOut(T* to);
 	void Reallocate(size_t new_cap);
 	size_t CalculateCapacity(size_t cap) const;
 
 public:
 	CircularBuffer();
 	explicit CircularBuffer(size_t count);
+	explicit CircularBuffer(MemoryResource& resource);
+	CircularBuffer(size_t count, MemoryResource& resource);
 	CircularBuffer(const CircularBuffer& other);
 	CircularBuffer& operator=(const CircularBuffer& other);
 	~CircularBuffer();
@@ -31,32 +56,53 @@ public:
 	size_t Size() const;
 	size_t Capacity() const;
 	void PushBack(const T& value);
+	void PushBack(T&& value);
+	void PushBackN(const T* values, size_t count);
 	void PushFront(const T& value);
 	void PopBack();
 	void PopFront();
+	size_t PopFrontN(T* out, size_t count);
+	template <class F>
+	void ForEach(F&& fn) const;
 	void Clear();
 	void Reserve(size_t new_cap);
 	void Swap(CircularBuffer& other);
+	MemoryResource* Resource() const;
 };
 
-template<class T>
-void Copy(const T* from, size_t size, T* to);
-template<class T>
-void Swap(T& lhs, T& rhs);
+template <class T>
+size_t CircularBuffer<T>::Position(size_t idx) const {
+	return (front_ + idx) & (capacity_ - 1);
+}
+
+// Copies the contents, in order, to the start of to.
+template <class T>
+void CircularBuffer<T>::CopyOut(T* to) const {
+	const size_t first = size_ < capacity_ - front_ ? size_ : capacity_ - front_;
+	Copy(buf_ + front_, first, to);
+	Copy(buf_, size_ - first, to + first);
+}
+
+// Moves the contents, in order, to the start of to.
+template <class T>
+void CircularBuffer<T>::MoveOut(T* to) {
+	const size_t first = size_ < capacity_ - front_ ? size_ : capacity_ - front_;
+	Move(buf_ + front_, first, to);
+	Move(buf_, size_ - first, to + first);
+}
 
 template <class T>
 void CircularBuffer<T>::Reallocate(size_t new_cap) {
-	T* new_buf = new T[new_cap];
-	for (size_t i = 0; i < size_; ++i) {
-		new_buf[i] = (*this)[i];
-	}
-	delete[] buf_;
+	T* new_buf = NewArray<T>(resource_, new_cap, kAlign);
+	MoveOut(new_buf);
+	DeleteArray(resource_, buf_, capacity_, kAlign);
 	capacity_ = new_cap;
 	buf_ = new_buf;
 	front_ = 0;
-	back_ = size_ == 0 ? 0 : size_ - 1;
 }
 
+// Smallest power of two that holds cap elements and is at least the current
+// capacity.
 template <class T>
 size_t CircularBuffer<T>::CalculateCapacity(size_t cap) const {
 	size_t new_cap = capacity_ == 0 ? 1 : capacity_;
@@ -67,19 +113,33 @@ size_t CircularBuffer<T>::CalculateCapacity(size_t cap) const {
 }
 
 template <class T>
-CircularBuffer<T>::CircularBuffer() : capacity_(0), size_(0), front_(0), back_(0), buf_(nullptr) {
+CircularBuffer<T>::CircularBuffer() : capacity_(0), size_(0), front_(0), buf_(nullptr), resource_(nullptr) {
 }
 
 template <class T>
-CircularBuffer<T>::CircularBuffer(size_t count) : capacity_(count), size_(0), front_(0), back_(0) {
-	buf_ = new T[capacity_];
+CircularBuffer<T>::CircularBuffer(size_t count) :
+capacity_(0), size_(0), front_(0), buf_(nullptr), resource_(nullptr) {
+	Reserve(count);
+}
+
+template <class T>
+CircularBuffer<T>::CircularBuffer(MemoryResource& resource) :
+capacity_(0), size_(0), front_(0), buf_(nullptr), resource_(&resource) {
+}
+
+template <class T>
+CircularBuffer<T>::CircularBuffer(size_t count, MemoryResource& resource) :
+capacity_(0), size_(0), front_(0), buf_(nullptr), resource_(&resource) {
+	Reserve(count);
 }
 
 template <class T>
 CircularBuffer<T>::CircularBuffer(const CircularBuffer& other) :
-capacity_(other.capacity_), size_(other.size_), front_(other.front_), back_(other.back_) {
-	buf_ = new T[capacity_];
-	Copy(other.buf_, size_, buf_);
+capacity_(other.capacity_), size_(other.size_), front_(0), buf_(nullptr), resource_(nullptr) {
+	if (capacity_ != 0) {
+		buf_ = NewArray<T>(resource_, capacity_, kAlign);
+		other.CopyOut(buf_);
+	}
 }
 
 template <class T>
@@ -87,31 +147,31 @@ CircularBuffer<T>& CircularBuffer<T>::operator=(const CircularBuffer& other) {
 	if (this == &other) {
 		return *this;
 	}
-	else if (other.size_ > capacity_) {
-		Reallocate(other.capacity_);
+	if (other.size_ > capacity_) {
+		T* new_buf = NewArray<T>(resource_, other.capacity_, kAlign);
+		DeleteArray(resource_, buf_, capacity_, kAlign);
+		buf_ = new_buf;
+		capacity_ = other.capacity_;
 	}
+	other.CopyOut(buf_);
 	size_ = other.size_;
 	front_ = 0;
-	back_ = size_ - 1;
-	for (size_t i = 0; i < size_; ++i) {
-		(*this)[i] = other[i];
-	}
 	return *this;
 }
 
 template <class T>
 CircularBuffer<T>::~CircularBuffer() {
-	delete[] buf_;
+	DeleteArray(resource_, buf_, capacity_, kAlign);
 }
 
 template <class T>
 const T CircularBuffer<T>::operator[](size_t idx) const {
-	return buf_[(idx + front_) % capacity_];
+	return buf_[Position(idx)];
 }
 
 template <class T>
 T& CircularBuffer<T>::operator[](size_t idx) {
-	return buf_[(idx + front_) % capacity_];
+	return buf_[Position(idx)];
 }
 
 template <class T>
@@ -121,7 +181,7 @@ const T CircularBuffer<T>::Front() const {
 
 template <class T>
 const T CircularBuffer<T>::Back() const {
-	return buf_[back_];
+	return buf_[Position(size_ - 1)];
 }
 
 template <class T>
@@ -131,7 +191,7 @@ T& CircularBuffer<T>::Front() {
 
 template <class T>
 T& CircularBuffer<T>::Back() {
-	return buf_[back_];
+	return buf_[Position(size_ - 1)];
 }
 
 template <class T>
@@ -149,51 +209,116 @@ size_t CircularBuffer<T>::Capacity() const {
 	return capacity_;
 }
 
+// value may be an element of this buffer, so it is copied before growing.
 template <class T>
 void CircularBuffer<T>::PushBack(const T& value) {
-	const size_t cap = CalculateCapacity(size_ + 1);
-	if (cap > capacity_) {
-		Reallocate(cap);
+	if (size_ == capacity_) {
+		T copy(value);
+		Reallocate(CalculateCapacity(size_ + 1));
+		buf_[Position(size_)] = std::move(copy);
+	} else {
+		buf_[Position(size_)] = value;
+	}
+	++size_;
+}
+
+template <class T>
+void CircularBuffer<T>::PushBack(T&& value) {
+	if (size_ == capacity_) {
+		T moved(std::move(value));
+		Reallocate(CalculateCapacity(size_ + 1));
+		buf_[Position(size_)] = std::move(moved);
+	} else {
+		buf_[Position(size_)] = std::move(value);
 	}
-	back_ = (back_ + 1) % capacity_;
 	++size_;
-	buf_[back_] = value;
+}
+
+// values must not point into this buffer.
+template <class T>
+void CircularBuffer<T>::PushBackN(const T* values, size_t count) {
+	if (size_ + count > capacity_) {
+		Reallocate(CalculateCapacity(size_ + count));
+	}
+	const size_t back = Position(size_);
+	const size_t first = count < capacity_ - back ? count : capacity_ - back;
+	Copy(values, first, buf_ + back);
+	Copy(values + first, count - first, buf_);
+	size_ += count;
 }
 
 template <class T>
 void CircularBuffer<T>::PushFront(const T& value) {
-	const size_t cap = CalculateCapacity(size_ + 1);
-	if (cap > capacity_) {
-		Reallocate(cap);
+	if (size_ == capacity_) {
+		T copy(value);
+		Reallocate(CalculateCapacity(size_ + 1));
+		front_ = capacity_ - 1;
+		buf_[front_] = std::move(copy);
+	} else {
+		front_ = (front_ - 1) & (capacity_ - 1);
+		buf_[front_] = value;
 	}
-	front_ = (front_ + capacity_ - 1) % capacity_;
 	++size_;
-	buf_[front_] = value;
 }
 
 template <class T>
 void CircularBuffer<T>::PopBack() {
 	--size_;
-	back_ = (back_ + capacity_ - 1) % capacity_;
 }
 
-
 template <class T>
 void CircularBuffer<T>::PopFront() {
 	--size_;
-	front_ = (front_ + 1) % capacity_;
+	front_ = Position(1);
+}
+
+// Moves up to count elements from the front to out and returns how many.
+template <class T>
+size_t CircularBuffer<T>::PopFrontN(T* out, size_t count) {
+	const size_t n = count < size_ ? count : size_;
+	const size_t first = n < capacity_ - front_ ? n : capacity_ - front_;
+	Move(buf_ + front_, first, out);
+	Move(buf_, n - first, out + first);
+	front_ = Position(n);
+	size_ -= n;
+	return n;
+}
+
+// Calls fn on every element from front to back, a cache line at a time,
+// prefetching kPrefetchBytes ahead within each segment.
+template <class T>
+template <class F>
+void CircularBuffer<T>::ForEach(F&& fn) const {
+	const size_t line = 64 / sizeof(T) == 0 ? 1 : 64 / sizeof(T);
+	const size_t ahead = kPrefetchBytes / sizeof(T) == 0 ? 1 : kPrefetchBytes / sizeof(T);
+	const size_t first = size_ < capacity_ - front_ ? size_ : capacity_ - front_;
+	const T* segments[2] = {buf_ + front_, buf_};
+	const size_t sizes[2] = {first, size_ - first};
+	for (size_t s = 0; s < 2; ++s) {
+		const T* data = segments[s];
+		const size_t size = sizes[s];
+		for (size_t i = 0; i < size; i += line) {
+			if (i + ahead < size) {
+				__builtin_prefetch(data + i + ahead);
+			}
+			const size_t end = size - i < line ? size : i + line;
+			for (size_t j = i; j < end; ++j) {
+				fn(data[j]);
+			}
+		}
+	}
 }
 
 template <class T>
 void CircularBuffer<T>::Clear() {
 	size_ = 0;
-	front_ = back_ = 0;
+	front_ = 0;
 }
 
 template <class T>
 void CircularBuffer<T>::Reserve(size_t new_cap) {
 	if (capacity_ < new_cap) {
-		Reallocate(new_cap);
+		Reallocate(CalculateCapacity(new_cap));
 	}
 }
 
@@ -203,22 +328,12 @@ void CircularBuffer<T>::Swap(CircularBuffer& other) {
 	::Swap(capacity_, other.capacity_);
 	::Swap(size_, other.size_);
 	::Swap(front_, other.front_);
-	::Swap(back_, other.back_);
+	::Swap(resource_, other.resource_);
 }
 
-
-template<class T>
-void Copy(const T* from, size_t size, T* to) {
-	for (size_t i = 0; i < size; ++i) {
-		to[i] = from[i];
-	}
-}
-
-template<class T>
-void Swap(T& lhs, T& rhs) {
-	T temp = lhs;
-	lhs = rhs;
-	rhs = temp;
+template <class T>
+MemoryResource* CircularBuffer<T>::Resource() const {
+	return resource_;
 }
 
 #endif
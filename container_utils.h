@@ -0,0 +1,58 @@
+#ifndef CONTAINER_UTILS_H
+#define CONTAINER_UTILS_H
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+template<class T>
+void Copy(const T* from, size_t size, T* to);
+template<class T>
+void Move(T* from, size_t size, T* to);
+template<class T>
+void Fill(T* buf, size_t size, const T& value);
+template<class T>
+void Swap(T& lhs, T& rhs);
+
+// Ranges must not overlap.
+template<class T>
+void Copy(const T* from, size_t size, T* to) {
+	if constexpr (std::is_trivially_copyable<T>::value) {
+		if (size != 0) {
+			memcpy(static_cast<void*>(to), static_cast<const void*>(from), size * sizeof(T));
+		}
+	} else {
+		for (size_t i = 0; i < size; ++i) {
+			to[i] = from[i];
+		}
+	}
+}
+
+// Move-assigns; the source elements are left moved-from. Ranges must not
+// overlap.
+template<class T>
+void Move(T* from, size_t size, T* to) {
+	if constexpr (std::is_trivially_copyable<T>::value) {
+		Copy(from, size, to);
+	} else {
+		for (size_t i = 0; i < size; ++i) {
+			to[i] = std::move(from[i]);
+		}
+	}
+}
+
+template<class T>
+void Fill(T* buf, size_t size, const T& value) {
+	for (size_t i = 0; i < size; ++i) {
+		buf[i] = value;
+	}
+}
+
+template <class T>
+void Swap(T& lhs, T& rhs) {
+	T temp = lhs;
+	lhs = rhs;
+	rhs = temp;
+}
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef FUNCTION_H
+#define FUNCTION_H
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include "any.h"
+
+class BadFunctionCall : public std::exception {
+public:
+	const char* what() const noexcept override {
+		return "BadFunctionCall";
+	}
+};
+
+template<class Sig, size_t InlineSize, bool Copyable>
+class FunctionBase;
+
+// Type-erased callable on top of the Any storage: the callable lives in an
+// InlineStorage and is reached through the static Derived<F, Inline> helpers.
+// Operations go through one constant table of function pointers per type
+// rather than virtual calls.
+template<class R, class... Args, size_t InlineSize, bool Copyable>
+class FunctionBase<R(Args...), InlineSize, Copyable> {
+	struct VTable {
+		R (*invoke_)(void* storage, Args&&... args);
+		void (*copy_)(const void* from, void* to);
+		void (*move_)(void* from, void* to) noexcept;
+		void (*destroy_)(void* storage) noexcept;
+	};
+
+	template<class F>
+	using Handler = Derived<F, InlineStorage<InlineSize>::template Fits<F>::value>;
+
+	template<class F>
+	static R Invoke(void* storage, Args&&... args);
+	template<class F>
+	static constexpr void (*CopyFn())(const void*, void*);
+	template<class F>
+	static constexpr VTable kVTable = {&Invoke<F>, CopyFn<F>(), &Handler<F>::MoveValue, &Handler<F>::DestroyValue};
+
+	mutable InlineStorage<InlineSize> storage_;
+	const VTable* vtable_;
+
+	template<class F>
+	static bool IsNull(const F& fn);
+
+protected:
+	FunctionBase();
+	~FunctionBase();
+
+	template<class F>
+	void Construct(F&& fn);
+	void CopyFrom(const FunctionBase& other);
+	void MoveFrom(FunctionBase& other) noexcept;
+
+public:
+	template<class F>
+	using EnableIfCallable = typename std::enable_if<
+		!std::is_base_of<FunctionBase, typename std::decay<F>::type>::value &&
+		std::is_invocable_r<R, typename std::decay<F>::type&, Args...>::value>::type;
+
+	void Reset();
+	R operator()(Args... args) const;
+	explicit operator bool() const;
+};
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+template <class F>
+R FunctionBase<R(Args...), InlineSize, Copyable>::Invoke(void* storage, Args&&... args) {
+	if constexpr (std::is_void<R>::value) {
+		std::invoke(*Handler<F>::Get(storage), std::forward<Args>(args)...);
+	} else {
+		return std::invoke(*Handler<F>::Get(storage), std::forward<Args>(args)...);
+	}
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+template <class F>
+constexpr void (*FunctionBase<R(Args...), InlineSize, Copyable>::CopyFn())(const void*, void*) {
+	if constexpr (Copyable) {
+		return &Handler<F>::CopyValue;
+	} else {
+		return nullptr;
+	}
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+template <class F>
+bool FunctionBase<R(Args...), InlineSize, Copyable>::IsNull(const F& fn) {
+	if constexpr (std::is_pointer<F>::value || std::is_member_pointer<F>::value) {
+		return fn == nullptr;
+	} else {
+		return false;
+	}
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+FunctionBase<R(Args...), InlineSize, Copyable>::FunctionBase() : vtable_(nullptr) {
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+FunctionBase<R(Args...), InlineSize, Copyable>::~FunctionBase() {
+	Reset();
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+template <class F>
+void FunctionBase<R(Args...), InlineSize, Copyable>::Construct(F&& fn) {
+	typedef typename std::decay<F>::type Callable;
+	if (IsNull(fn)) {
+		return;
+	}
+	Handler<Callable>::Construct(storage_.data_, std::forward<F>(fn));
+	vtable_ = &kVTable<Callable>;
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+void FunctionBase<R(Args...), InlineSize, Copyable>::CopyFrom(const FunctionBase& other) {
+	if (other.vtable_ != nullptr) {
+		other.vtable_->copy_(other.storage_.data_, storage_.data_);
+		vtable_ = other.vtable_;
+	}
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+void FunctionBase<R(Args...), InlineSize, Copyable>::MoveFrom(FunctionBase& other) noexcept {
+	if (other.vtable_ != nullptr) {
+		other.vtable_->move_(other.storage_.data_, storage_.data_);
+		vtable_ = other.vtable_;
+		other.vtable_ = nullptr;
+	}
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+void FunctionBase<R(Args...), InlineSize, Copyable>::Reset() {
+	if (vtable_ != nullptr) {
+		vtable_->destroy_(storage_.data_);
+		vtable_ = nullptr;
+	}
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+R FunctionBase<R(Args...), InlineSize, Copyable>::operator()(Args... args) const {
+	if (vtable_ == nullptr) {
+		throw BadFunctionCall();
+	}
+	return vtable_->invoke_(storage_.data_, std::forward<Args>(args)...);
+}
+
+template <class R, class... Args, size_t InlineSize, bool Copyable>
+FunctionBase<R(Args...), InlineSize, Copyable>::operator bool() const {
+	return vtable_ != nullptr;
+}
+
+
+template<class Sig, size_t InlineSize = 3 * sizeof(void*)>
+class Function;
+
+template<class R, class... Args, size_t InlineSize>
+class Function<R(Args...), InlineSize> : public FunctionBase<R(Args...), InlineSize, true> {
+	typedef FunctionBase<R(Args...), InlineSize, true> Impl;
+
+public:
+	Function();
+	Function(std::nullptr_t);
+	template<class F, class = typename Impl::template EnableIfCallable<F>>
+	Function(F&& fn);
+	Function(const Function& other);
+	Function(Function&& other) noexcept;
+	Function& operator=(const Function& other);
+	Function& operator=(Function&& other) noexcept;
+	template<class F, class = typename Impl::template EnableIfCallable<F>>
+	Function& operator=(F&& fn);
+	~Function() = default;
+
+	void Swap(Function& other);
+};
+
+// Move-only counterpart of Function; accepts callables that cannot be copied.
+template<class Sig, size_t InlineSize = 3 * sizeof(void*)>
+class UniqueFunction;
+
+template<class R, class... Args, size_t InlineSize>
+class UniqueFunction<R(Args...), InlineSize> : public FunctionBase<R(Args...), InlineSize, false> {
+	typedef FunctionBase<R(Args...), InlineSize, false> Impl;
+
+public:
+	UniqueFunction();
+	UniqueFunction(std::nullptr_t);
+	template<class F, class = typename Impl::template EnableIfCallable<F>>
+	UniqueFunction(F&& fn);
+	UniqueFunction(const UniqueFunction& other) = delete;
+	UniqueFunction(UniqueFunction&& other) noexcept;
+	UniqueFunction& operator=(const UniqueFunction& other) = delete;
+	UniqueFunction& operator=(UniqueFunction&& other) noexcept;
+	template<class F, class = typename Impl::template EnableIfCallable<F>>
+	UniqueFunction& operator=(F&& fn);
+	~UniqueFunction() = default;
+
+	void Swap(UniqueFunction& other);
+};
+
+template <class R, class... Args, size_t InlineSize>
+Function<R(Args...), InlineSize>::Function() {
+}
+
+template <class R, class... Args, size_t InlineSize>
+Function<R(Args...), InlineSize>::Function(std::nullptr_t) {
+}
+
+template <class R, class... Args, size_t InlineSize>
+template <class F, class>
+Function<R(Args...), InlineSize>::Function(F&& fn) {
+	this->Construct(std::forward<F>(fn));
+}
+
+template <class R, class... Args, size_t InlineSize>
+Function<R(Args...), InlineSize>::Function(const Function& other) {
+	this->CopyFrom(other);
+}
+
+template <class R, class... Args, size_t InlineSize>
+Function<R(Args...), InlineSize>::Function(Function&& other) noexcept {
+	this->MoveFrom(other);
+}
+
+template <class R, class... Args, size_t InlineSize>
+Function<R(Args...), InlineSize>& Function<R(Args...), InlineSize>::operator=(const Function& other) {
+	if (this != &other) {
+		Function(other).Swap(*this);
+	}
+	return *this;
+}
+
+template <class R, class... Args, size_t InlineSize>
+Function<R(Args...), InlineSize>& Function<R(Args...), InlineSize>::operator=(Function&& other) noexcept {
+	if (this != &other) {
+		this->Reset();
+		this->MoveFrom(other);
+	}
+	return *this;
+}
+
+template <class R, class... Args, size_t InlineSize>
+template <class F, class>
+Function<R(Args...), InlineSize>& Function<R(Args...), InlineSize>::operator=(F&& fn) {
+	Function(std::forward<F>(fn)).Swap(*this);
+	return *this;
+}
+
+template <class R, class... Args, size_t InlineSize>
+void Function<R(Args...), InlineSize>::Swap(Function& other) {
+	Function tmp(std::move(other));
+	other = std::move(*this);
+	*this = std::move(tmp);
+}
+
+template <class R, class... Args, size_t InlineSize>
+UniqueFunction<R(Args...), InlineSize>::UniqueFunction() {
+}
+
+template <class R, class... Args, size_t InlineSize>
+UniqueFunction<R(Args...), InlineSize>::UniqueFunction(std::nullptr_t) {
+}
+
+template <class R, class... Args, size_t InlineSize>
+template <class F, class>
+UniqueFunction<R(Args...), InlineSize>::UniqueFunction(F&& fn) {
+	this->Construct(std::forward<F>(fn));
+}
+
+template <class R, class... Args, size_t InlineSize>
+UniqueFunction<R(Args...), InlineSize>::UniqueFunction(UniqueFunction&& other) noexcept {
+	this->MoveFrom(other);
+}
+
+template <class R, class... Args, size_t InlineSize>
+UniqueFunction<R(Args...), InlineSize>& UniqueFunction<R(Args...), InlineSize>::operator=(UniqueFunction&& other) noexcept {
+	if (this != &other) {
+		this->Reset();
+		this->MoveFrom(other);
+	}
+	return *this;
+}
+
+template <class R, class... Args, size_t InlineSize>
+template <class F, class>
+UniqueFunction<R(Args...), InlineSize>& UniqueFunction<R(Args...), InlineSize>::operator=(F&& fn) {
+	UniqueFunction(std::forward<F>(fn)).Swap(*this);
+	return *this;
+}
+
+template <class R, class... Args, size_t InlineSize>
+void UniqueFunction<R(Args...), InlineSize>::Swap(UniqueFunction& other) {
+	UniqueFunction tmp(std::move(other));
+	other = std::move(*this);
+	*this = std::move(tmp);
+}
+
+#endif // FUNCTION_H
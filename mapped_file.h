@@ -0,0 +1,224 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cerrno>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "string_split.h"
+#include "string_view.h"
+
+// Read-only mapping of a whole file. The contents are exposed as one
+// StringView that is valid until the MappedFile is closed or destroyed; it is
+// not null-terminated. The mapping is advised for sequential access, and
+// kPopulate prefaults every page up front (where MAP_POPULATE exists) so that
+// a following scan does not take page faults.
+class MappedFile {
+	const char* data_;
+	size_t size_;
+
+public:
+	enum Flags {
+		kDefault = 0,
+		kPopulate = 1,
+	};
+
+	MappedFile();
+	explicit MappedFile(const char* path, int flags = kDefault);
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(const MappedFile& other) = delete;
+	MappedFile& operator=(MappedFile&& other);
+	~MappedFile();
+
+	void Open(const char* path, int flags = kDefault);
+	void Close();
+	bool IsOpen() const;
+	StringView View() const;
+	const char* Data() const;
+	size_t Size() const;
+	void Swap(MappedFile& other);
+};
+
+// Calls on_line(state, line) for every line of text (as split by Lines) on up
+// to `threads` workers, 0 meaning one per hardware thread. The text is cut
+// into contiguous chunks that end right after a newline; each worker folds its
+// chunk into a private copy of identity, and the per-chunk states are combined
+// in text order with reduce(accumulated, chunk_state). Inputs too small to be
+// worth splitting run on the calling thread. An exception thrown by a worker
+// is rethrown after all workers have finished.
+template <class T, class LineFn, class Reduce>
+T ForEachLineChunked(StringView text, T identity, LineFn on_line, Reduce reduce, size_t threads = 0);
+
+inline MappedFile::MappedFile() : data_(nullptr), size_(0) {
+}
+
+inline MappedFile::MappedFile(const char* path, int flags) : data_(nullptr), size_(0) {
+	Open(path, flags);
+}
+
+inline MappedFile::MappedFile(MappedFile&& other) : data_(other.data_), size_(other.size_) {
+	other.data_ = nullptr;
+	other.size_ = 0;
+}
+
+inline MappedFile& MappedFile::operator=(MappedFile&& other) {
+	if (this != &other) {
+		Close();
+		Swap(other);
+	}
+	return *this;
+}
+
+inline MappedFile::~MappedFile() {
+	Close();
+}
+
+inline void MappedFile::Open(const char* path, int flags) {
+	Close();
+	const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), path);
+	}
+	struct stat st;
+	if (::fstat(fd, &st) != 0) {
+		const int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), path);
+	}
+	const size_t size = static_cast<size_t>(st.st_size);
+	if (size == 0) {
+		::close(fd);
+		return;
+	}
+	int map_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	if (flags & kPopulate) {
+		map_flags |= MAP_POPULATE;
+	}
+#else
+	(void)flags;
+#endif
+	void* data = ::mmap(nullptr, size, PROT_READ, map_flags, fd, 0);
+	const int error = errno;
+	::close(fd);
+	if (data == MAP_FAILED) {
+		throw std::system_error(error, std::generic_category(), path);
+	}
+	::madvise(data, size, MADV_SEQUENTIAL);
+	data_ = static_cast<const char*>(data);
+	size_ = size;
+}
+
+inline void MappedFile::Close() {
+	if (data_ != nullptr) {
+		::munmap(const_cast<char*>(data_), size_);
+		data_ = nullptr;
+		size_ = 0;
+	}
+}
+
+inline bool MappedFile::IsOpen() const {
+	return data_ != nullptr;
+}
+
+inline StringView MappedFile::View() const {
+	return StringView(data_, size_);
+}
+
+inline const char* MappedFile::Data() const {
+	return data_;
+}
+
+inline size_t MappedFile::Size() const {
+	return size_;
+}
+
+inline void MappedFile::Swap(MappedFile& other) {
+	std::swap(data_, other.data_);
+	std::swap(size_, other.size_);
+}
+
+template <class T, class LineFn, class Reduce>
+T ForEachLineChunked(StringView text, T identity, LineFn on_line, Reduce reduce, size_t threads) {
+	const static size_t kMinChunk = 256 * 1024;
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	if (threads > text.Size() / kMinChunk) {
+		threads = text.Size() / kMinChunk;
+	}
+	if (threads <= 1) {
+		T state = identity;
+		for (StringView line : Lines(text)) {
+			on_line(state, line);
+		}
+		return state;
+	}
+
+	std::vector<StringView> chunks;
+	size_t begin = 0;
+	for (size_t i = 1; i <= threads && begin < text.Size(); ++i) {
+		size_t end = text.Size();
+		if (i < threads) {
+			const size_t target = text.Size() / threads * i;
+			end = target < begin ? begin : target;
+			end = text.Find('\n', end);
+			end = end == StringView::kNpos ? text.Size() : end + 1;
+		}
+		chunks.push_back(StringView(text.Data() + begin, end - begin));
+		begin = end;
+	}
+
+	std::vector<T> states(chunks.size(), identity);
+	std::vector<std::exception_ptr> errors(chunks.size());
+	std::vector<std::thread> workers;
+	workers.reserve(chunks.size() - 1);
+	auto work = [&](size_t idx) {
+		try {
+			T state = identity;
+			for (StringView line : Lines(chunks[idx])) {
+				on_line(state, line);
+			}
+			states[idx] = std::move(state);
+		} catch (...) {
+			errors[idx] = std::current_exception();
+		}
+	};
+	size_t started = 1;
+	try {
+		for (; started < chunks.size(); ++started) {
+			workers.emplace_back(work, started);
+		}
+	} catch (const std::system_error&) {
+		// Out of threads: the remaining chunks run here.
+	}
+	work(0);
+	for (size_t i = started; i < chunks.size(); ++i) {
+		work(i);
+	}
+	for (size_t i = 0; i < workers.size(); ++i) {
+		workers[i].join();
+	}
+	for (size_t i = 0; i < errors.size(); ++i) {
+		if (errors[i]) {
+			std::rethrow_exception(errors[i]);
+		}
+	}
+
+	T result = std::move(states[0]);
+	for (size_t i = 1; i < states.size(); ++i) {
+		result = reduce(std::move(result), std::move(states[i]));
+	}
+	return result;
+}
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef MEMORY_RESOURCE_H
+#define MEMORY_RESOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+// Source of raw memory for containers. Containers hold a MemoryResource*,
+// where null stands for the global heap, and return every block with the
+// size and alignment it was allocated with.
+class MemoryResource {
+public:
+	virtual void* Allocate(size_t size, size_t align) = 0;
+	virtual void Deallocate(void* ptr, size_t size, size_t align) noexcept = 0;
+	virtual ~MemoryResource() = default;
+};
+
+inline void* AllocateBytes(MemoryResource* resource, size_t size, size_t align) {
+	if (resource != nullptr) {
+		return resource->Allocate(size, align);
+	}
+	if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+		return ::operator new(size, std::align_val_t(align));
+	}
+	return ::operator new(size);
+}
+
+inline void DeallocateBytes(MemoryResource* resource, void* ptr, size_t size, size_t align) noexcept {
+	if (resource != nullptr) {
+		resource->Deallocate(ptr, size, align);
+	} else if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+		::operator delete(ptr, std::align_val_t(align));
+	} else {
+		::operator delete(ptr);
+	}
+}
+
+// new T[count] and delete[] on a resource, optionally over-aligned:
+// elements are default-initialized, as with new T[count]. With a null
+// resource and no extra alignment these are exactly new[] and delete[].
+template <class T>
+T* NewArray(MemoryResource* resource, size_t count, size_t align = alignof(T)) {
+	if (resource == nullptr && align <= alignof(T)) {
+		return new T[count];
+	}
+	if (count > SIZE_MAX / sizeof(T)) {
+		throw std::bad_array_new_length();
+	}
+	T* ptr = static_cast<T*>(AllocateBytes(resource, count * sizeof(T), align));
+	size_t i = 0;
+	try {
+		for (; i < count; ++i) {
+			::new (static_cast<void*>(ptr + i)) T;
+		}
+	} catch (...) {
+		while (i > 0) {
+			ptr[--i].~T();
+		}
+		DeallocateBytes(resource, ptr, count * sizeof(T), align);
+		throw;
+	}
+	return ptr;
+}
+
+template <class T>
+void DeleteArray(MemoryResource* resource, T* ptr, size_t count, size_t align = alignof(T)) noexcept {
+	if (resource == nullptr && align <= alignof(T)) {
+		delete[] ptr;
+		return;
+	}
+	if (ptr == nullptr) {
+		return;
+	}
+	if (!std::is_trivially_destructible<T>::value) {
+		for (size_t i = 0; i < count; ++i) {
+			ptr[i].~T();
+		}
+	}
+	DeallocateBytes(resource, ptr, count * sizeof(T), align);
+}
+
+// Standard allocator over a MemoryResource, for code written against the
+// allocator interface such as SharedPtr control blocks.
+template <class T>
+class ResourceAllocator {
+	MemoryResource* resource_;
+
+	template <class U>
+	friend class ResourceAllocator;
+
+public:
+	typedef T value_type;
+
+	explicit ResourceAllocator(MemoryResource* resource = nullptr);
+	template <class U>
+	ResourceAllocator(const ResourceAllocator<U>& other);
+
+	T* allocate(size_t count);
+	void deallocate(T* ptr, size_t count) noexcept;
+	MemoryResource* Resource() const;
+};
+
+template <class T, class U>
+bool operator==(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs);
+template <class T, class U>
+bool operator!=(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs);
+
+template <class T>
+ResourceAllocator<T>::ResourceAllocator(MemoryResource* resource) : resource_(resource) {
+}
+
+template <class T>
+template <class U>
+ResourceAllocator<T>::ResourceAllocator(const ResourceAllocator<U>& other) : resource_(other.resource_) {
+}
+
+template <class T>
+T* ResourceAllocator<T>::allocate(size_t count) {
+	if (count > SIZE_MAX / sizeof(T)) {
+		throw std::bad_array_new_length();
+	}
+	return static_cast<T*>(AllocateBytes(resource_, count * sizeof(T), alignof(T)));
+}
+
+template <class T>
+void ResourceAllocator<T>::deallocate(T* ptr, size_t count) noexcept {
+	DeallocateBytes(resource_, ptr, count * sizeof(T), alignof(T));
+}
+
+template <class T>
+MemoryResource* ResourceAllocator<T>::Resource() const {
+	return resource_;
+}
+
+template <class T, class U>
+bool operator==(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs) {
+	return lhs.Resource() == rhs.Resource();
+}
+
+template <class T, class U>
+bool operator!=(const ResourceAllocator<T>& lhs, const ResourceAllocator<U>& rhs) {
+	return !(lhs == rhs);
+}
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <mutex>
+#include <new>
+#include <utility>
+#include "memory_resource.h"
+#include "shared_ptr.h"
+#include "unique_ptr.h"
+#include "vector.h"
+
+// Recycles storage for objects of type T. Objects handed out by
+// MakeShared and MakeUnique are returned to the pool when their owner
+// releases them, so the pool must outlive them. Storage honours alignof(T),
+// including over-aligned types.
+template <class T>
+class ObjectPool {
+	std::mutex mutex_;
+	Vector<void*> free_;
+
+	void* AllocateStorage();
+
+public:
+	class Deleter {
+		ObjectPool* pool_;
+
+	public:
+		explicit Deleter(ObjectPool* pool);
+		void operator()(T* ptr) const;
+	};
+
+	ObjectPool();
+	ObjectPool(const ObjectPool& other) = delete;
+	ObjectPool& operator=(const ObjectPool& other) = delete;
+	~ObjectPool();
+
+	template <class... Args>
+	T* Acquire(Args&&... args);
+	void Release(T* ptr);
+	template <class... Args>
+	SharedPtr<T> MakeShared(Args&&... args);
+	template <class... Args>
+	UniquePtr<T, Deleter> MakeUnique(Args&&... args);
+	void Reserve(size_t count);
+	size_t Available();
+};
+
+template <class T>
+ObjectPool<T>::Deleter::Deleter(ObjectPool* pool) : pool_(pool) {
+}
+
+template <class T>
+void ObjectPool<T>::Deleter::operator()(T* ptr) const {
+	pool_->Release(ptr);
+}
+
+template <class T>
+ObjectPool<T>::ObjectPool() {
+}
+
+template <class T>
+ObjectPool<T>::~ObjectPool() {
+	for (size_t i = 0; i < free_.Size(); ++i) {
+		DeallocateBytes(nullptr, free_[i], sizeof(T), alignof(T));
+	}
+}
+
+template <class T>
+void* ObjectPool<T>::AllocateStorage() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!free_.Empty()) {
+			void* storage = free_.Back();
+			free_.PopBack();
+			return storage;
+		}
+	}
+	return AllocateBytes(nullptr, sizeof(T), alignof(T));
+}
+
+template <class T>
+template <class... Args>
+T* ObjectPool<T>::Acquire(Args&&... args) {
+	void* storage = AllocateStorage();
+	try {
+		return ::new (storage) T(std::forward<Args>(args)...);
+	} catch (...) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		free_.PushBack(storage);
+		throw;
+	}
+}
+
+template <class T>
+void ObjectPool<T>::Release(T* ptr) {
+	ptr->~T();
+	std::lock_guard<std::mutex> lock(mutex_);
+	free_.PushBack(ptr);
+}
+
+template <class T>
+template <class... Args>
+SharedPtr<T> ObjectPool<T>::MakeShared(Args&&... args) {
+	return SharedPtr<T>(Acquire(std::forward<Args>(args)...), Deleter(this));
+}
+
+template <class T>
+template <class... Args>
+UniquePtr<T, typename ObjectPool<T>::Deleter> ObjectPool<T>::MakeUnique(Args&&... args) {
+	return UniquePtr<T, Deleter>(Acquire(std::forward<Args>(args)...), Deleter(this));
+}
+
+template <class T>
+void ObjectPool<T>::Reserve(size_t count) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	while (free_.Size() < count) {
+		free_.PushBack(AllocateBytes(nullptr, sizeof(T), alignof(T)));
+	}
+}
+
+template <class T>
+size_t ObjectPool<T>::Available() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return free_.Size();
+}
+
+#endif
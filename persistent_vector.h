@@ -0,0 +1,265 @@
+#ifndef PERSISTENT_VECTOR_H
+#define PERSISTENT_VECTOR_H
+
+#include <cstddef>
+#include <stdexcept>
+#include "container_utils.h"
+#include "shared_ptr.h"
+
+// Vector stored as a 32-way trie of fixed-size leaves, plus a tail leaf that
+// takes appends until it is full and moves into the trie. Chunks are
+// reference counted with SharedPtr and shared between copies, so copying a
+// PersistentVector is O(1) and makes a snapshot. A write touches only the
+// leaf and the path above it, O(log32 n) chunks, and copies a chunk only if
+// another vector still references it; chunks referenced once are changed in
+// place, so a writer that keeps no snapshots writes like a plain array.
+//
+// A PersistentVector object is not thread-safe, but a copy is unaffected by
+// writes to the original. The usual pattern is a writer that hands out
+// Snapshot() to readers on other threads and keeps appending and updating.
+// T must be default-constructible, as for Vector.
+template <class T>
+class PersistentVector {
+	const static size_t kBits = 5;
+	const static size_t kWidth = size_t(1) << kBits;
+	const static size_t kMask = kWidth - 1;
+
+	struct Node {
+		virtual ~Node() = default;
+	};
+
+	struct Leaf : Node {
+		T values_[kWidth];
+	};
+
+	struct Branch : Node {
+		SharedPtr<Node> children_[kWidth];
+	};
+
+	SharedPtr<Node> root_;
+	SharedPtr<Node> tail_;
+	size_t size_;
+	size_t shift_;
+	// Set while tail_ is known to be referenced only by this vector, so that
+	// appends skip the reference count check. Copies clear it on both sides.
+	mutable bool own_tail_;
+
+	size_t TailOffset() const;
+	const Leaf* LeafFor(size_t idx) const;
+	template <class N>
+	static N* Writable(SharedPtr<Node>& slot);
+	SharedPtr<Node> NewPath(size_t shift, const SharedPtr<Node>& leaf);
+	void PushTail(SharedPtr<Node>& slot, size_t shift, const SharedPtr<Node>& leaf);
+
+public:
+	PersistentVector();
+	PersistentVector(const PersistentVector& other);
+	PersistentVector& operator=(const PersistentVector& other);
+
+	size_t Size() const;
+	bool Empty() const;
+	void PushBack(const T& value);
+	void Set(size_t idx, const T& value);
+	T& Mutable(size_t idx);
+	const T& operator[](size_t idx) const;
+	const T& At(size_t idx) const;
+	const T& Front() const;
+	const T& Back() const;
+	PersistentVector Snapshot() const;
+	template <class F>
+	void ForEach(F&& fn) const;
+	void Clear();
+	void Swap(PersistentVector& other);
+};
+
+template <class T>
+size_t PersistentVector<T>::TailOffset() const {
+	return size_ < kWidth ? 0 : (size_ - 1) & ~kMask;
+}
+
+template <class T>
+const typename PersistentVector<T>::Leaf* PersistentVector<T>::LeafFor(size_t idx) const {
+	if (idx >= TailOffset()) {
+		return static_cast<const Leaf*>(tail_.Get());
+	}
+	const Node* node = root_.Get();
+	for (size_t shift = shift_; shift > 0; shift -= kBits) {
+		node = static_cast<const Branch*>(node)->children_[(idx >> shift) & kMask].Get();
+	}
+	return static_cast<const Leaf*>(node);
+}
+
+// Makes the chunk in slot private to this vector, copying it if it is shared.
+template <class T>
+template <class N>
+N* PersistentVector<T>::Writable(SharedPtr<Node>& slot) {
+	if (slot.UseCount() != 1) {
+		slot = SharedPtr<Node>(new N(*static_cast<const N*>(slot.Get())));
+	}
+	return static_cast<N*>(slot.Get());
+}
+
+template <class T>
+SharedPtr<typename PersistentVector<T>::Node> PersistentVector<T>::NewPath(size_t shift, const SharedPtr<Node>& leaf) {
+	if (shift == 0) {
+		return leaf;
+	}
+	Branch* branch = new Branch();
+	SharedPtr<Node> node(branch);
+	branch->children_[0] = NewPath(shift - kBits, leaf);
+	return node;
+}
+
+// Hangs a full leaf under the branch in slot, whose children sit shift bits
+// down; the leaf covers elements from size_ - kWidth.
+template <class T>
+void PersistentVector<T>::PushTail(SharedPtr<Node>& slot, size_t shift, const SharedPtr<Node>& leaf) {
+	Branch* branch = Writable<Branch>(slot);
+	const size_t idx = ((size_ - 1) >> shift) & kMask;
+	if (shift == kBits) {
+		branch->children_[idx] = leaf;
+	} else if (branch->children_[idx]) {
+		PushTail(branch->children_[idx], shift - kBits, leaf);
+	} else {
+		branch->children_[idx] = NewPath(shift - kBits, leaf);
+	}
+}
+
+template <class T>
+PersistentVector<T>::PersistentVector() :
+root_(new Branch()), tail_(new Leaf()), size_(0), shift_(kBits), own_tail_(true) {
+}
+
+template <class T>
+PersistentVector<T>::PersistentVector(const PersistentVector& other) :
+root_(other.root_), tail_(other.tail_), size_(other.size_), shift_(other.shift_), own_tail_(false) {
+	other.own_tail_ = false;
+}
+
+template <class T>
+PersistentVector<T>& PersistentVector<T>::operator=(const PersistentVector& other) {
+	PersistentVector(other).Swap(*this);
+	return *this;
+}
+
+template <class T>
+size_t PersistentVector<T>::Size() const {
+	return size_;
+}
+
+template <class T>
+bool PersistentVector<T>::Empty() const {
+	return size_ == 0;
+}
+
+template <class T>
+void PersistentVector<T>::PushBack(const T& value) {
+	const size_t tail_size = size_ - TailOffset();
+	if (tail_size < kWidth) {
+		if (!own_tail_) {
+			Writable<Leaf>(tail_);
+			own_tail_ = true;
+		}
+		static_cast<Leaf*>(tail_.Get())->values_[tail_size] = value;
+		++size_;
+		return;
+	}
+	// The tail is full: it becomes the leaf for elements [size_ - kWidth, size_).
+	if ((size_ >> kBits) > (size_t(1) << shift_)) {
+		Branch* branch = new Branch();
+		SharedPtr<Node> root(branch);
+		branch->children_[0] = root_;
+		branch->children_[1] = NewPath(shift_, tail_);
+		root_ = root;
+		shift_ += kBits;
+	} else {
+		PushTail(root_, shift_, tail_);
+	}
+	Leaf* leaf = new Leaf();
+	tail_ = SharedPtr<Node>(leaf);
+	own_tail_ = true;
+	leaf->values_[0] = value;
+	++size_;
+}
+
+template <class T>
+void PersistentVector<T>::Set(size_t idx, const T& value) {
+	Mutable(idx) = value;
+}
+
+// Reference to an element for writing in place, copying the chunks on its
+// path that are shared with snapshots. It stays valid until the next write or
+// snapshot.
+template <class T>
+T& PersistentVector<T>::Mutable(size_t idx) {
+	if (idx >= size_) {
+		throw std::out_of_range("PersistentVector::Mutable");
+	}
+	if (idx >= TailOffset()) {
+		Leaf* tail = Writable<Leaf>(tail_);
+		own_tail_ = true;
+		return tail->values_[idx & kMask];
+	}
+	SharedPtr<Node>* slot = &root_;
+	for (size_t shift = shift_; shift > 0; shift -= kBits) {
+		slot = &Writable<Branch>(*slot)->children_[(idx >> shift) & kMask];
+	}
+	return Writable<Leaf>(*slot)->values_[idx & kMask];
+}
+
+template <class T>
+const T& PersistentVector<T>::operator[](size_t idx) const {
+	return LeafFor(idx)->values_[idx & kMask];
+}
+
+template <class T>
+const T& PersistentVector<T>::At(size_t idx) const {
+	if (idx >= size_) {
+		throw std::out_of_range("PersistentVector::At");
+	}
+	return (*this)[idx];
+}
+
+template <class T>
+const T& PersistentVector<T>::Front() const {
+	return (*this)[0];
+}
+
+template <class T>
+const T& PersistentVector<T>::Back() const {
+	return (*this)[size_ - 1];
+}
+
+template <class T>
+PersistentVector<T> PersistentVector<T>::Snapshot() const {
+	return *this;
+}
+
+// Calls fn on every element in order, one leaf lookup per kWidth elements.
+template <class T>
+template <class F>
+void PersistentVector<T>::ForEach(F&& fn) const {
+	for (size_t base = 0; base < size_; base += kWidth) {
+		const Leaf* leaf = LeafFor(base);
+		const size_t count = size_ - base < kWidth ? size_ - base : kWidth;
+		for (size_t i = 0; i < count; ++i) {
+			fn(leaf->values_[i]);
+		}
+	}
+}
+
+template <class T>
+void PersistentVector<T>::Clear() {
+	PersistentVector().Swap(*this);
+}
+
+template <class T>
+void PersistentVector<T>::Swap(PersistentVector& other) {
+	root_.Swap(other.root_);
+	tail_.Swap(other.tail_);
+	::Swap(size_, other.size_);
+	::Swap(shift_, other.shift_);
+	::Swap(own_tail_, other.own_tail_);
+}
+
+#endif
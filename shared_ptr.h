@@ -2,6 +2,12 @@
 #define SHARED_PTR_H
 
 #include<algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 class BadWeakPtr : public std::exception {
 public:
@@ -14,16 +20,566 @@ public:
 template<class T>
 class SharedPtr;
 
-struct Counter {
-	size_t shared_cnt_;
-	size_t weak_cnt_;
+// Per-thread slab of fixed-size blocks for control blocks. Blocks are carved
+// from slabs of kBlocksPerSlab and recycled through per-thread free lists
+// by size class. A free list longer than kMaxFree hands kBlocksPerSlab blocks
+// to a global depot, so blocks freed by a thread that does not allocate (the
+// consumer side of a producer/consumer pair) flow back to the allocating one;
+// a thread also returns its lists to the depot on exit, and refills from the
+// depot, a batch at a time, before carving a new slab. Slab memory is kept for
+// the lifetime of the process.
+class CounterSlab {
+	struct FreeBlock {
+		FreeBlock* next_;
+	};
+	const static size_t kGranularity = 16;
+	const static size_t kClasses = 8;
+	const static size_t kBlocksPerSlab = 64;
+	const static size_t kMaxFree = 2 * kBlocksPerSlab;
+
+	FreeBlock* free_[kClasses];
+	size_t count_[kClasses];
+
+	struct Depot {
+		std::mutex mutex_;
+		FreeBlock* free_[kClasses];
+	};
+	static Depot& GetDepot();
+	static CounterSlab* Current();
+	static size_t SizeClass(size_t size);
+	static void Push(FreeBlock*& list, void* ptr);
+	static FreeBlock* Split(FreeBlock*& list, size_t count, size_t* taken);
+	void Refill(size_t cls);
+	void Flush(size_t cls);
 
-	Counter() : shared_cnt_(0), weak_cnt_(0) {
+public:
+	CounterSlab();
+	CounterSlab(const CounterSlab& other) = delete;
+	CounterSlab& operator=(const CounterSlab& other) = delete;
+	~CounterSlab();
+
+	static void* Allocate(size_t size);
+	static void Deallocate(void* ptr, size_t size);
+};
+
+inline thread_local bool counter_slab_dead = false;
+
+inline CounterSlab::Depot& CounterSlab::GetDepot() {
+	static Depot* depot = new Depot();
+	return *depot;
+}
+
+inline CounterSlab* CounterSlab::Current() {
+	if (counter_slab_dead) {
+		return nullptr;
+	}
+	thread_local CounterSlab slab;
+	return &slab;
+}
+
+inline size_t CounterSlab::SizeClass(size_t size) {
+	return (size + kGranularity - 1) / kGranularity - 1;
+}
+
+inline void CounterSlab::Push(FreeBlock*& list, void* ptr) {
+	FreeBlock* block = static_cast<FreeBlock*>(ptr);
+	block->next_ = list;
+	list = block;
+}
+
+// Detaches up to count blocks from the front of list and returns the last of
+// them, or nullptr if the list is empty.
+inline CounterSlab::FreeBlock* CounterSlab::Split(FreeBlock*& list, size_t count, size_t* taken) {
+	FreeBlock* last = nullptr;
+	FreeBlock* block = list;
+	*taken = 0;
+	while (block != nullptr && *taken < count) {
+		last = block;
+		block = block->next_;
+		++*taken;
+	}
+	if (last != nullptr) {
+		last->next_ = nullptr;
+	}
+	list = block;
+	return last;
+}
+
+inline CounterSlab::CounterSlab() : free_(), count_() {
+}
+
+inline CounterSlab::~CounterSlab() {
+	counter_slab_dead = true;
+	Depot& depot = GetDepot();
+	std::lock_guard<std::mutex> lock(depot.mutex_);
+	for (size_t cls = 0; cls < kClasses; ++cls) {
+		while (free_[cls] != nullptr) {
+			FreeBlock* block = free_[cls];
+			free_[cls] = block->next_;
+			Push(depot.free_[cls], block);
+		}
+	}
+}
+
+inline void CounterSlab::Refill(size_t cls) {
+	Depot& depot = GetDepot();
+	{
+		std::lock_guard<std::mutex> lock(depot.mutex_);
+		FreeBlock* list = depot.free_[cls];
+		if (list != nullptr) {
+			Split(depot.free_[cls], kBlocksPerSlab, &count_[cls]);
+			free_[cls] = list;
+			return;
+		}
 	}
-	Counter(size_t shared, size_t weak) : shared_cnt_(shared), weak_cnt_(weak) {
+	const size_t block_size = (cls + 1) * kGranularity;
+	char* slab = static_cast<char*>(::operator new(block_size * kBlocksPerSlab));
+	for (size_t i = kBlocksPerSlab; i > 0; --i) {
+		Push(free_[cls], slab + (i - 1) * block_size);
 	}
+	count_[cls] = kBlocksPerSlab;
+}
+
+inline void CounterSlab::Flush(size_t cls) {
+	FreeBlock* first = free_[cls];
+	size_t taken;
+	FreeBlock* last = Split(free_[cls], kBlocksPerSlab, &taken);
+	count_[cls] -= taken;
+	Depot& depot = GetDepot();
+	std::lock_guard<std::mutex> lock(depot.mutex_);
+	last->next_ = depot.free_[cls];
+	depot.free_[cls] = first;
+}
+
+inline void* CounterSlab::Allocate(size_t size) {
+	const size_t cls = SizeClass(size);
+	CounterSlab* slab = Current();
+	if (cls >= kClasses || slab == nullptr) {
+		return ::operator new(size);
+	}
+	if (slab->free_[cls] == nullptr) {
+		slab->Refill(cls);
+	}
+	FreeBlock* block = slab->free_[cls];
+	slab->free_[cls] = block->next_;
+	--slab->count_[cls];
+	return block;
+}
+
+inline void CounterSlab::Deallocate(void* ptr, size_t size) {
+	const size_t cls = SizeClass(size);
+	if (cls >= kClasses) {
+		::operator delete(ptr);
+		return;
+	}
+	CounterSlab* slab = Current();
+	if (slab != nullptr) {
+		Push(slab->free_[cls], ptr);
+		if (++slab->count_[cls] > kMaxFree) {
+			slab->Flush(cls);
+		}
+		return;
+	}
+	Depot& depot = GetDepot();
+	std::lock_guard<std::mutex> lock(depot.mutex_);
+	Push(depot.free_[cls], ptr);
+}
+
+// Biased reference counting. The thread that creates an object (its owner)
+// counts its own references in biased_cnt_ with plain loads and stores, all
+// other threads use atomic RMWs on shared_cnt_. shared_cnt_ packs a signed
+// count (in units of kOne) with two flags: kMerged is set once the biased
+// count has been folded into the shared one, after that every thread uses
+// shared_cnt_; kQueued is set when a non-owner drives the unmerged count below
+// zero (it released a reference the owner counted), which hands the counter to
+// the owner's queue so that the owner merges it. Queued counters are destroyed
+// only by the queue merge. If the owner thread has exited, the releasing
+// thread merges the counter itself.
+// weak_cnt_ counts WeakPtrs plus one for the whole group of SharedPtrs.
+class Counter {
+	uint64_t owner_;
+	std::atomic<size_t> biased_cnt_;
+	std::atomic<int64_t> shared_cnt_;
+	std::atomic<size_t> weak_cnt_;
+	const static int64_t kMerged = 1;
+	const static int64_t kQueued = 2;
+	const static int64_t kOne = 4;
+
+	bool IsBiased() const;
+	int64_t StrongCount(int64_t cnt) const;
+	bool DecShared();
+	bool MergeQueued();
+	friend class BiasedRegistry;
+
+protected:
+	virtual void DestroyObject() = 0;
+	virtual void DestroySelf();
+
+public:
+	Counter();
+	Counter(const Counter& other) = delete;
+	Counter& operator=(const Counter& other) = delete;
+	virtual ~Counter() = default;
+
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr, size_t size);
+
+	void IncShared();
+	bool TryIncShared();
+	void ReleaseShared();
+	size_t SharedCount() const;
+	bool Expired() const;
+	void IncWeak();
+	void ReleaseWeak();
 };
 
+template<class T>
+class CounterImpl : public Counter {
+	T* ptr_;
+
+protected:
+	void DestroyObject() override;
+
+public:
+	explicit CounterImpl(T* ptr);
+};
+
+template<class T, class Deleter>
+class CounterDeleter : public Counter {
+	T* ptr_;
+	Deleter deleter_;
+
+protected:
+	void DestroyObject() override;
+
+public:
+	CounterDeleter(T* ptr, Deleter deleter);
+};
+
+// Control block placed in memory obtained from a user allocator instead of
+// the control block slab.
+template<class T, class Deleter, class Alloc>
+class CounterAlloc : public CounterDeleter<T, Deleter> {
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<CounterAlloc> BlockAlloc;
+	BlockAlloc alloc_;
+
+protected:
+	void DestroySelf() override;
+
+public:
+	CounterAlloc(T* ptr, Deleter deleter, const Alloc& alloc);
+
+	static Counter* Create(T* ptr, Deleter deleter, const Alloc& alloc);
+};
+
+// Per-thread queue of counters released past their biased count by other
+// threads, guarded by the registry mutex.
+struct BiasedQueue {
+	std::vector<Counter*> pending_;
+	std::atomic<bool> has_pending_;
+
+	BiasedQueue() : has_pending_(false) {
+	}
+};
+
+class BiasedRegistry {
+	std::mutex mutex_;
+	std::unordered_map<uint64_t, BiasedQueue*> queues_;
+	uint64_t next_id_;
+
+	BiasedRegistry() : next_id_(1) {
+	}
+
+public:
+	const static uint64_t kNoOwner = UINT64_MAX;
+
+	static BiasedRegistry& Instance();
+	static uint64_t CurrentThread();
+	uint64_t Register(BiasedQueue* queue);
+	void Unregister(uint64_t id, BiasedQueue* queue);
+	void Submit(Counter* cnt);
+	void Drain(BiasedQueue* queue);
+};
+
+class BiasedThread {
+	BiasedQueue queue_;
+	uint64_t id_;
+
+public:
+	BiasedThread();
+	~BiasedThread();
+
+	static BiasedThread& Current();
+	void Drain();
+};
+
+inline thread_local uint64_t biased_thread_id = 0;
+
+// Lets a long-lived owner thread release objects whose last references were
+// dropped by other threads without creating new SharedPtrs.
+void MergeBiasedCounters();
+
+inline BiasedRegistry& BiasedRegistry::Instance() {
+	static BiasedRegistry* registry = new BiasedRegistry();
+	return *registry;
+}
+
+inline uint64_t BiasedRegistry::CurrentThread() {
+	if (biased_thread_id == 0) {
+		BiasedThread::Current();
+	}
+	return biased_thread_id;
+}
+
+inline uint64_t BiasedRegistry::Register(BiasedQueue* queue) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	const uint64_t id = next_id_++;
+	queues_[id] = queue;
+	return id;
+}
+
+inline void BiasedRegistry::Unregister(uint64_t id, BiasedQueue* queue) {
+	std::vector<Counter*> dead;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queues_.erase(id);
+		biased_thread_id = kNoOwner;
+		for (Counter* cnt : queue->pending_) {
+			if (cnt->MergeQueued()) {
+				dead.push_back(cnt);
+			}
+		}
+		queue->pending_.clear();
+	}
+	for (Counter* cnt : dead) {
+		cnt->DestroyObject();
+		cnt->ReleaseWeak();
+	}
+}
+
+inline void BiasedRegistry::Submit(Counter* cnt) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto it = queues_.find(cnt->owner_);
+		if (it != queues_.end()) {
+			it->second->pending_.push_back(cnt);
+			it->second->has_pending_.store(true, std::memory_order_release);
+			return;
+		}
+		if (!cnt->MergeQueued()) {
+			return;
+		}
+	}
+	cnt->DestroyObject();
+	cnt->ReleaseWeak();
+}
+
+inline void BiasedRegistry::Drain(BiasedQueue* queue) {
+	std::vector<Counter*> pending;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pending.swap(queue->pending_);
+		queue->has_pending_.store(false, std::memory_order_relaxed);
+	}
+	for (Counter* cnt : pending) {
+		if (cnt->MergeQueued()) {
+			cnt->DestroyObject();
+			cnt->ReleaseWeak();
+		}
+	}
+}
+
+inline BiasedThread::BiasedThread() : id_(BiasedRegistry::Instance().Register(&queue_)) {
+	biased_thread_id = id_;
+}
+
+inline BiasedThread::~BiasedThread() {
+	BiasedRegistry::Instance().Unregister(id_, &queue_);
+}
+
+inline BiasedThread& BiasedThread::Current() {
+	thread_local BiasedThread thread;
+	return thread;
+}
+
+inline void BiasedThread::Drain() {
+	if (queue_.has_pending_.load(std::memory_order_acquire)) {
+		BiasedRegistry::Instance().Drain(&queue_);
+	}
+}
+
+inline void MergeBiasedCounters() {
+	if (BiasedRegistry::CurrentThread() != BiasedRegistry::kNoOwner) {
+		BiasedThread::Current().Drain();
+	}
+}
+
+inline Counter::Counter() : owner_(BiasedRegistry::CurrentThread()), biased_cnt_(1), shared_cnt_(0), weak_cnt_(1) {
+	if (owner_ == BiasedRegistry::kNoOwner) {
+		biased_cnt_.store(0, std::memory_order_relaxed);
+		shared_cnt_.store(kOne | kMerged, std::memory_order_relaxed);
+	} else {
+		BiasedThread::Current().Drain();
+	}
+}
+
+inline void Counter::DestroySelf() {
+	delete this;
+}
+
+inline void* Counter::operator new(size_t size) {
+	return CounterSlab::Allocate(size);
+}
+
+inline void Counter::operator delete(void* ptr, size_t size) {
+	CounterSlab::Deallocate(ptr, size);
+}
+
+inline bool Counter::IsBiased() const {
+	return owner_ == biased_thread_id && (shared_cnt_.load(std::memory_order_relaxed) & kMerged) == 0;
+}
+
+inline void Counter::IncShared() {
+	if (IsBiased()) {
+		biased_cnt_.store(biased_cnt_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	} else {
+		shared_cnt_.fetch_add(kOne, std::memory_order_relaxed);
+	}
+}
+
+// Strong references left for a given value of shared_cnt_. Until the merge a
+// queued counter can be dead with a positive biased count: the owner counted
+// references that other threads have since released.
+inline int64_t Counter::StrongCount(int64_t cnt) const {
+	int64_t count = (cnt & ~(kMerged | kQueued)) / kOne;
+	if ((cnt & kMerged) == 0) {
+		count += static_cast<int64_t>(biased_cnt_.load(std::memory_order_relaxed));
+	}
+	return count;
+}
+
+inline bool Counter::TryIncShared() {
+	if (IsBiased()) {
+		if (StrongCount(shared_cnt_.load(std::memory_order_relaxed)) <= 0) {
+			return false;
+		}
+		IncShared();
+		return true;
+	}
+	int64_t cnt = shared_cnt_.load(std::memory_order_relaxed);
+	while (StrongCount(cnt) > 0) {
+		if (shared_cnt_.compare_exchange_weak(cnt, cnt + kOne, std::memory_order_relaxed)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Returns true if the caller has to destroy the object.
+inline bool Counter::DecShared() {
+	if (IsBiased()) {
+		const size_t biased = biased_cnt_.load(std::memory_order_relaxed) - 1;
+		biased_cnt_.store(biased, std::memory_order_relaxed);
+		if (biased != 0) {
+			return false;
+		}
+		return shared_cnt_.fetch_or(kMerged, std::memory_order_acq_rel) == 0;
+	}
+	int64_t cnt = shared_cnt_.load(std::memory_order_relaxed);
+	int64_t next;
+	do {
+		next = cnt - kOne;
+		if ((next & (kMerged | kQueued)) == 0 && next < 0) {
+			next |= kQueued;
+		}
+	} while (!shared_cnt_.compare_exchange_weak(cnt, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+	if ((next & kQueued) != 0 && (cnt & kQueued) == 0) {
+		BiasedRegistry::Instance().Submit(this);
+		return false;
+	}
+	return next == kMerged;
+}
+
+// Folds the biased count into the shared one and clears kQueued. Called by the
+// owner, or under the registry mutex once the owner has exited.
+inline bool Counter::MergeQueued() {
+	int64_t add = -kQueued;
+	if ((shared_cnt_.load(std::memory_order_relaxed) & kMerged) == 0) {
+		add += static_cast<int64_t>(biased_cnt_.load(std::memory_order_relaxed)) * kOne + kMerged;
+		biased_cnt_.store(0, std::memory_order_relaxed);
+	}
+	return shared_cnt_.fetch_add(add, std::memory_order_acq_rel) + add == kMerged;
+}
+
+inline void Counter::ReleaseShared() {
+	if (DecShared()) {
+		DestroyObject();
+		ReleaseWeak();
+	}
+}
+
+inline size_t Counter::SharedCount() const {
+	const int64_t count = StrongCount(shared_cnt_.load(std::memory_order_acquire));
+	return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
+inline bool Counter::Expired() const {
+	return StrongCount(shared_cnt_.load(std::memory_order_acquire)) <= 0;
+}
+
+inline void Counter::IncWeak() {
+	weak_cnt_.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void Counter::ReleaseWeak() {
+	if (weak_cnt_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		DestroySelf();
+	}
+}
+
+template <class T>
+CounterImpl<T>::CounterImpl(T* ptr) : ptr_(ptr) {
+}
+
+template <class T>
+void CounterImpl<T>::DestroyObject() {
+	delete ptr_;
+}
+
+template <class T, class Deleter>
+CounterDeleter<T, Deleter>::CounterDeleter(T* ptr, Deleter deleter) : ptr_(ptr), deleter_(std::move(deleter)) {
+}
+
+template <class T, class Deleter>
+void CounterDeleter<T, Deleter>::DestroyObject() {
+	deleter_(ptr_);
+}
+
+template <class T, class Deleter, class Alloc>
+CounterAlloc<T, Deleter, Alloc>::CounterAlloc(T* ptr, Deleter deleter, const Alloc& alloc) :
+CounterDeleter<T, Deleter>(ptr, std::move(deleter)), alloc_(alloc) {
+}
+
+template <class T, class Deleter, class Alloc>
+Counter* CounterAlloc<T, Deleter, Alloc>::Create(T* ptr, Deleter deleter, const Alloc& alloc) {
+	BlockAlloc block_alloc(alloc);
+	CounterAlloc* cnt = std::allocator_traits<BlockAlloc>::allocate(block_alloc, 1);
+	try {
+		::new (static_cast<void*>(cnt)) CounterAlloc(ptr, std::move(deleter), alloc);
+	} catch (...) {
+		std::allocator_traits<BlockAlloc>::deallocate(block_alloc, cnt, 1);
+		throw;
+	}
+	return cnt;
+}
+
+template <class T, class Deleter, class Alloc>
+void CounterAlloc<T, Deleter, Alloc>::DestroySelf() {
+	BlockAlloc block_alloc(std::move(alloc_));
+	this->~CounterAlloc();
+	std::allocator_traits<BlockAlloc>::deallocate(block_alloc, this, 1);
+}
+
 template<class T>
 class WeakPtr {
 	T* ptr_;
@@ -56,6 +612,10 @@ class SharedPtr {
 public:
 	SharedPtr();
 	SharedPtr(T* object);
+	template<class Deleter>
+	SharedPtr(T* object, Deleter deleter);
+	template<class Deleter, class Alloc>
+	SharedPtr(T* object, Deleter deleter, const Alloc& alloc);
 	SharedPtr(const SharedPtr& other);
 	SharedPtr(SharedPtr&& other) noexcept;
 	SharedPtr(const WeakPtr<T>& other);
@@ -64,6 +624,10 @@ public:
 	~SharedPtr();
 
 	void Reset(T* ptr = nullptr);
+	template<class Deleter>
+	void Reset(T* ptr, Deleter deleter);
+	template<class Deleter, class Alloc>
+	void Reset(T* ptr, Deleter deleter, const Alloc& alloc);
 	void Swap(SharedPtr<T>& other);
 	T* Get() const;
 	size_t UseCount() const;
@@ -79,12 +643,51 @@ SharedPtr<T>::SharedPtr() : ptr_(nullptr), cnt_(nullptr) {
 
 
 template <class T>
-SharedPtr<T>::SharedPtr(T* object) : ptr_(object), cnt_(object == nullptr ? nullptr : new Counter(1, 0)) {
+SharedPtr<T>::SharedPtr(T* object) : ptr_(object), cnt_(nullptr) {
+	if (object == nullptr) {
+		return;
+	}
+	try {
+		cnt_ = new CounterImpl<T>(object);
+	} catch (...) {
+		delete object;
+		throw;
+	}
+}
+
+template <class T>
+template <class Deleter>
+SharedPtr<T>::SharedPtr(T* object, Deleter deleter) : ptr_(object), cnt_(nullptr) {
+	if (object == nullptr) {
+		return;
+	}
+	try {
+		cnt_ = new CounterDeleter<T, Deleter>(object, deleter);
+	} catch (...) {
+		deleter(object);
+		throw;
+	}
+}
+
+template <class T>
+template <class Deleter, class Alloc>
+SharedPtr<T>::SharedPtr(T* object, Deleter deleter, const Alloc& alloc) : ptr_(object), cnt_(nullptr) {
+	if (object == nullptr) {
+		return;
+	}
+	try {
+		cnt_ = CounterAlloc<T, Deleter, Alloc>::Create(object, deleter, alloc);
+	} catch (...) {
+		deleter(object);
+		throw;
+	}
 }
 
 template <class T>
 SharedPtr<T>::SharedPtr(const SharedPtr& other) : ptr_(other.ptr_), cnt_(other.cnt_) {
-	++cnt_->shared_cnt_;
+	if (cnt_ != nullptr) {
+		cnt_->IncShared();
+	}
 }
 
 template <class T>
@@ -95,12 +698,9 @@ SharedPtr<T>::SharedPtr(SharedPtr&& other) noexcept : ptr_(other.ptr_), cnt_(oth
 
 template <class T>
 SharedPtr<T>::SharedPtr(const WeakPtr<T>& other) : ptr_(other.Get()), cnt_(other.cnt_) {
-	if (other.Expired()) {
+	if (cnt_ == nullptr || !cnt_->TryIncShared()) {
 		throw BadWeakPtr();
 	}
-	if (cnt_ != nullptr && ptr_ != nullptr) {
-		++cnt_->shared_cnt_;
-	}
 }
 
 template <class T>
@@ -111,7 +711,9 @@ SharedPtr<T>& SharedPtr<T>::operator=(const SharedPtr& other) {
 	Reset();
 	ptr_ = other.ptr_;
 	cnt_ = other.cnt_;
-	++cnt_->shared_cnt_;
+	if (cnt_ != nullptr) {
+		cnt_->IncShared();
+	}
 	return *this;
 }
 
@@ -127,22 +729,26 @@ SharedPtr<T>& SharedPtr<T>::operator=(SharedPtr&& other) noexcept {
 
 template <class T>
 SharedPtr<T>::~SharedPtr() {
-	Reset();
+	if (cnt_ != nullptr) {
+		cnt_->ReleaseShared();
+	}
 }
 
 template <class T>
 void SharedPtr<T>::Reset(T* ptr) {
-	if (cnt_ != nullptr && cnt_->shared_cnt_ == 1 && cnt_->weak_cnt_ == 0) {
-		delete ptr_;
-		delete cnt_;
-	} else if (cnt_ != nullptr && cnt_->shared_cnt_ == 1) {
-		delete ptr_;
-		--cnt_->shared_cnt_;
-	} else if (cnt_ != nullptr && cnt_->shared_cnt_ != 0) {
-		--cnt_->shared_cnt_;
-	}
-	ptr_ = ptr;
-	cnt_ = ptr == nullptr ? nullptr : new Counter(1, 0);
+	SharedPtr<T>(ptr).Swap(*this);
+}
+
+template <class T>
+template <class Deleter>
+void SharedPtr<T>::Reset(T* ptr, Deleter deleter) {
+	SharedPtr<T>(ptr, std::move(deleter)).Swap(*this);
+}
+
+template <class T>
+template <class Deleter, class Alloc>
+void SharedPtr<T>::Reset(T* ptr, Deleter deleter, const Alloc& alloc) {
+	SharedPtr<T>(ptr, std::move(deleter), alloc).Swap(*this);
 }
 
 
@@ -156,7 +762,7 @@ size_t SharedPtr<T>::UseCount() const {
 	if (cnt_ == nullptr) {
 		return 0;
 	}
-	return cnt_->shared_cnt_;
+	return cnt_->SharedCount();
 }
 
 template <class T>
@@ -187,8 +793,8 @@ WeakPtr<T>::WeakPtr() : ptr_(nullptr), cnt_(nullptr) {
 
 template <class T>
 WeakPtr<T>::WeakPtr(const WeakPtr& other) : ptr_(other.ptr_), cnt_(other.cnt_) {
-	if (cnt_ != nullptr && ptr_ != nullptr) {
-		++cnt_->weak_cnt_;
+	if (cnt_ != nullptr) {
+		cnt_->IncWeak();
 	}
 }
 
@@ -200,8 +806,8 @@ WeakPtr<T>::WeakPtr(WeakPtr&& other) noexcept : ptr_(other.ptr_), cnt_(other.cnt
 
 template <class T>
 WeakPtr<T>::WeakPtr(const SharedPtr<T>& other) : ptr_(other.Get()), cnt_(other.cnt_) {
-	if (ptr_ != nullptr && cnt_ != nullptr) {
-		++cnt_->weak_cnt_;
+	if (cnt_ != nullptr) {
+		cnt_->IncWeak();
 	}
 }
 
@@ -213,7 +819,9 @@ WeakPtr<T>& WeakPtr<T>::operator=(const WeakPtr& other) {
 	Reset();
 	ptr_ = other.ptr_;
 	cnt_ = other.cnt_;
-	++cnt_->weak_cnt_;
+	if (cnt_ != nullptr) {
+		cnt_->IncWeak();
+	}
 	return *this;
 }
 
@@ -234,12 +842,12 @@ WeakPtr<T>::~WeakPtr() {
 
 template <class T>
 bool WeakPtr<T>::Expired() const {
-	return cnt_ == nullptr ? true : cnt_->shared_cnt_ == 0;
+	return cnt_ == nullptr ? true : cnt_->Expired();
 }
 
 template <class T>
 size_t WeakPtr<T>::UseCount() const {
-	return cnt_ == nullptr ? 0 : cnt_->shared_cnt_;
+	return cnt_ == nullptr ? 0 : cnt_->SharedCount();
 }
 
 template <class T>
@@ -250,10 +858,8 @@ void WeakPtr<T>::Swap(WeakPtr<T>& other) {
 
 template <class T>
 void WeakPtr<T>::Reset() {
-	if (cnt_ != nullptr && cnt_->weak_cnt_ == 1 && cnt_->shared_cnt_ == 0) {
-		delete cnt_;
-	} else if (cnt_ != nullptr && cnt_->weak_cnt_ != 0) {
-		--cnt_->weak_cnt_;
+	if (cnt_ != nullptr) {
+		cnt_->ReleaseWeak();
 	}
 	ptr_ = nullptr;
 	cnt_ = nullptr;
@@ -261,7 +867,12 @@ void WeakPtr<T>::Reset() {
 
 template <class T>
 SharedPtr<T> WeakPtr<T>::Lock() const {
-	return Expired() ? SharedPtr<T>() : SharedPtr<T>(*this);
+	SharedPtr<T> result;
+	if (cnt_ != nullptr && cnt_->TryIncShared()) {
+		result.ptr_ = ptr_;
+		result.cnt_ = cnt_;
+	}
+	return result;
 }
 
 template <class T>
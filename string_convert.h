@@ -0,0 +1,346 @@
+#ifndef STRING_CONVERT_H
+#define STRING_CONVERT_H
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include "string_view.h"
+
+enum class ParseError {
+	kOk,
+	kEmpty,
+	kInvalid,
+	kOverflow,
+};
+
+// Value or the reason parsing failed; nothing is thrown or allocated.
+template <class T>
+class ParseResult {
+	T value_;
+	ParseError error_;
+
+public:
+	ParseResult(T value);
+	ParseResult(ParseError error);
+
+	bool Ok() const;
+	explicit operator bool() const;
+	T Value() const;
+	T ValueOr(T fallback) const;
+	ParseError Error() const;
+};
+
+// Parsers accept the whole input or fail with kInvalid. Integers take an
+// optional '+' (and '-' for signed types); ParseHex takes an optional "0x".
+template <class T>
+ParseResult<T> ParseUInt(StringView str);
+template <class T>
+ParseResult<T> ParseInt(StringView str);
+template <class T>
+ParseResult<T> ParseHex(StringView str);
+ParseResult<double> ParseDouble(StringView str);
+
+// Formatters write into [buf, buf + size) without a terminating zero and
+// return the number of characters written, or 0 if the buffer is too small.
+// kMaxFormatChars is always enough.
+const size_t kMaxFormatChars = 32;
+template <class T>
+size_t FormatInt(T value, char* buf, size_t size);
+size_t FormatDouble(double value, char* buf, size_t size);
+
+template <class T>
+ParseResult<T>::ParseResult(T value) : value_(value), error_(ParseError::kOk) {
+}
+
+template <class T>
+ParseResult<T>::ParseResult(ParseError error) : value_(), error_(error) {
+}
+
+template <class T>
+bool ParseResult<T>::Ok() const {
+	return error_ == ParseError::kOk;
+}
+
+template <class T>
+ParseResult<T>::operator bool() const {
+	return Ok();
+}
+
+template <class T>
+T ParseResult<T>::Value() const {
+	return value_;
+}
+
+template <class T>
+T ParseResult<T>::ValueOr(T fallback) const {
+	return Ok() ? value_ : fallback;
+}
+
+template <class T>
+ParseError ParseResult<T>::Error() const {
+	return error_;
+}
+
+// SWAR digit helpers: eight ASCII characters are handled as one
+// little-endian 64-bit word.
+class DigitParser {
+public:
+	static uint64_t Load8(const char* p);
+	static bool AreEightDigits(uint64_t chunk);
+	static uint32_t ParseEightDigits(uint64_t chunk);
+	static ParseError ParseDecimal(const char* p, size_t size, uint64_t* value);
+};
+
+inline uint64_t DigitParser::Load8(const char* p) {
+	uint64_t chunk;
+	memcpy(&chunk, p, sizeof(chunk));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	chunk = __builtin_bswap64(chunk);
+#endif
+	return chunk;
+}
+
+inline bool DigitParser::AreEightDigits(uint64_t chunk) {
+	return ((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+		   0x3333333333333333ull;
+}
+
+inline uint32_t DigitParser::ParseEightDigits(uint64_t chunk) {
+	chunk -= 0x3030303030303030ull;
+	chunk = (chunk * 10) + (chunk >> 8);
+	chunk = (((chunk & 0x000000FF000000FFull) * 0x000F424000000064ull) +
+			 (((chunk >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >> 32;
+	return static_cast<uint32_t>(chunk);
+}
+
+// Parses digits only (no sign) into value, with overflow detection. Up to 16
+// digits are consumed eight at a time without overflow checks.
+inline ParseError DigitParser::ParseDecimal(const char* p, size_t size, uint64_t* value) {
+	if (size == 0) {
+		return ParseError::kEmpty;
+	}
+	uint64_t result = 0;
+	size_t i = 0;
+	while (i + 8 <= size && i + 8 <= 16) {
+		const uint64_t chunk = Load8(p + i);
+		if (!AreEightDigits(chunk)) {
+			break;
+		}
+		result = result * 100000000 + ParseEightDigits(chunk);
+		i += 8;
+	}
+	for (; i < size; ++i) {
+		const unsigned digit = static_cast<unsigned char>(p[i]) - '0';
+		if (digit > 9) {
+			return ParseError::kInvalid;
+		}
+		if (__builtin_mul_overflow(result, uint64_t(10), &result) || __builtin_add_overflow(result, uint64_t(digit), &result)) {
+			return ParseError::kOverflow;
+		}
+	}
+	*value = result;
+	return ParseError::kOk;
+}
+
+template <class T>
+ParseResult<T> ParseUInt(StringView str) {
+	static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "ParseUInt requires an unsigned integer type");
+	const char* p = str.Data();
+	size_t size = str.Size();
+	if (size != 0 && p[0] == '+') {
+		++p;
+		--size;
+	}
+	uint64_t value = 0;
+	const ParseError error = DigitParser::ParseDecimal(p, size, &value);
+	if (error != ParseError::kOk) {
+		return error;
+	}
+	if (value > std::numeric_limits<T>::max()) {
+		return ParseError::kOverflow;
+	}
+	return static_cast<T>(value);
+}
+
+template <class T>
+ParseResult<T> ParseInt(StringView str) {
+	static_assert(std::is_integral<T>::value, "ParseInt requires an integer type");
+	if constexpr (std::is_unsigned<T>::value) {
+		return ParseUInt<T>(str);
+	} else {
+		const char* p = str.Data();
+		size_t size = str.Size();
+		bool negative = false;
+		if (size != 0 && (p[0] == '-' || p[0] == '+')) {
+			negative = p[0] == '-';
+			++p;
+			--size;
+		}
+		uint64_t magnitude = 0;
+		const ParseError error = DigitParser::ParseDecimal(p, size, &magnitude);
+		if (error != ParseError::kOk) {
+			return error;
+		}
+		typedef typename std::make_unsigned<T>::type U;
+		const uint64_t limit = static_cast<uint64_t>(static_cast<U>(std::numeric_limits<T>::max())) + (negative ? 1 : 0);
+		if (magnitude > limit) {
+			return ParseError::kOverflow;
+		}
+		return negative ? static_cast<T>(U(0) - static_cast<U>(magnitude)) : static_cast<T>(magnitude);
+	}
+}
+
+template <class T>
+ParseResult<T> ParseHex(StringView str) {
+	static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "ParseHex requires an unsigned integer type");
+	const char* p = str.Data();
+	size_t size = str.Size();
+	if (size >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+		p += 2;
+		size -= 2;
+	}
+	if (size == 0) {
+		return ParseError::kEmpty;
+	}
+	T value = 0;
+	for (size_t i = 0; i < size; ++i) {
+		const unsigned c = static_cast<unsigned char>(p[i]);
+		unsigned digit;
+		if (c - '0' < 10u) {
+			digit = c - '0';
+		} else if ((c | 0x20u) - 'a' < 6u) {
+			digit = (c | 0x20u) - 'a' + 10;
+		} else {
+			return ParseError::kInvalid;
+		}
+		if (value > (std::numeric_limits<T>::max() >> 4)) {
+			return ParseError::kOverflow;
+		}
+		value = static_cast<T>((value << 4) | digit);
+	}
+	return value;
+}
+
+// Inputs with at most 19 significant digits whose mantissa fits in 53 bits
+// and whose decimal exponent is within +-22 are computed exactly with one
+// multiplication or division (Clinger's fast path). Everything else goes to
+// std::from_chars, which is correctly rounded (Eisel-Lemire in libstdc++).
+inline ParseResult<double> ParseDouble(StringView str) {
+	static const double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+									 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	const char* p = str.Data();
+	const char* end = p + str.Size();
+	if (p == end) {
+		return ParseError::kEmpty;
+	}
+	bool negative = false;
+	if (*p == '-' || *p == '+') {
+		negative = *p == '-';
+		++p;
+	}
+	const char* start = p;
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int64_t exponent = 0;
+	while (p != end && static_cast<unsigned>(*p - '0') < 10u) {
+		mantissa = mantissa * 10 + (*p - '0');
+		++digits;
+		++p;
+	}
+	if (p != end && *p == '.') {
+		++p;
+		const char* fraction = p;
+		while (p != end && static_cast<unsigned>(*p - '0') < 10u) {
+			mantissa = mantissa * 10 + (*p - '0');
+			++digits;
+			++p;
+		}
+		exponent -= p - fraction;
+	}
+	bool fast = digits > 0 && digits <= 19;
+	if (fast && p != end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool exp_negative = false;
+		if (p != end && (*p == '-' || *p == '+')) {
+			exp_negative = *p == '-';
+			++p;
+		}
+		int64_t exp_value = 0;
+		const char* exp_start = p;
+		while (p != end && static_cast<unsigned>(*p - '0') < 10u && exp_value < 100000) {
+			exp_value = exp_value * 10 + (*p - '0');
+			++p;
+		}
+		fast = p != exp_start;
+		exponent += exp_negative ? -exp_value : exp_value;
+	}
+	if (fast && p == end && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+		double value = static_cast<double>(mantissa);
+		value = exponent < 0 ? value / kPowers[-exponent] : value * kPowers[exponent];
+		return negative ? -value : value;
+	}
+	if (start != end && *start == '-') {
+		return ParseError::kInvalid;
+	}
+	double value = 0;
+	const std::from_chars_result result = std::from_chars(start, end, value);
+	if (result.ec == std::errc::invalid_argument || result.ptr != end) {
+		return ParseError::kInvalid;
+	}
+	if (result.ec == std::errc::result_out_of_range) {
+		return ParseError::kOverflow;
+	}
+	return negative ? -value : value;
+}
+
+template <class T>
+size_t FormatInt(T value, char* buf, size_t size) {
+	static_assert(std::is_integral<T>::value, "FormatInt requires an integer type");
+	static const char kDigitPairs[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+	typedef typename std::make_unsigned<T>::type U;
+	char tmp[24];
+	char* pos = tmp + sizeof(tmp);
+	U magnitude = static_cast<U>(value);
+	const bool negative = value < 0;
+	if (negative) {
+		magnitude = U(0) - magnitude;
+	}
+	while (magnitude >= 100) {
+		const unsigned pair = static_cast<unsigned>(magnitude % 100) * 2;
+		magnitude /= 100;
+		pos -= 2;
+		pos[0] = kDigitPairs[pair];
+		pos[1] = kDigitPairs[pair + 1];
+	}
+	if (magnitude >= 10) {
+		const unsigned pair = static_cast<unsigned>(magnitude) * 2;
+		pos -= 2;
+		pos[0] = kDigitPairs[pair];
+		pos[1] = kDigitPairs[pair + 1];
+	} else {
+		*--pos = static_cast<char>('0' + magnitude);
+	}
+	if (negative) {
+		*--pos = '-';
+	}
+	const size_t length = tmp + sizeof(tmp) - pos;
+	if (length > size) {
+		return 0;
+	}
+	memcpy(buf, pos, length);
+	return length;
+}
+
+// Shortest representation that parses back to the same value.
+inline size_t FormatDouble(double value, char* buf, size_t size) {
+	const std::to_chars_result result = std::to_chars(buf, buf + size, value);
+	return result.ec == std::errc() ? static_cast<size_t>(result.ptr - buf) : 0;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef STRING_HASH_H
+#define STRING_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "string_view.h"
+
+// wyhash (final version 4). The same function is instantiated with two
+// readers: LoadReader uses unaligned loads for runtime hashing and ByteReader
+// assembles words from bytes so that ConstHashString and ConstHashBytes work
+// in constant expressions. Both give the same result on little-endian targets.
+class WyHash {
+	constexpr static uint64_t kSecret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+											0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+
+	static constexpr void Mum(uint64_t& a, uint64_t& b);
+	static constexpr uint64_t Mix(uint64_t a, uint64_t b);
+
+public:
+	struct ByteReader {
+		static constexpr uint64_t Read8(const char* p);
+		static constexpr uint64_t Read4(const char* p);
+	};
+
+	struct LoadReader {
+		static uint64_t Read8(const char* p);
+		static uint64_t Read4(const char* p);
+	};
+
+	template<class Reader>
+	static constexpr uint64_t Hash(const char* p, size_t len, uint64_t seed);
+};
+
+inline constexpr void WyHash::Mum(uint64_t& a, uint64_t& b) {
+#ifdef __SIZEOF_INT128__
+	const unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+	a = static_cast<uint64_t>(r);
+	b = static_cast<uint64_t>(r >> 64);
+#else
+	const uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+	const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	const uint64_t t = rl + (rm0 << 32);
+	uint64_t lo = t + (rm1 << 32);
+	const uint64_t carry = (t < rl) + (lo < t);
+	const uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+	a = lo;
+	b = hi;
+#endif
+}
+
+inline constexpr uint64_t WyHash::Mix(uint64_t a, uint64_t b) {
+	Mum(a, b);
+	return a ^ b;
+}
+
+inline constexpr uint64_t WyHash::ByteReader::Read8(const char* p) {
+	uint64_t v = 0;
+	for (int i = 7; i >= 0; --i) {
+		v = (v << 8) | static_cast<unsigned char>(p[i]);
+	}
+	return v;
+}
+
+inline constexpr uint64_t WyHash::ByteReader::Read4(const char* p) {
+	uint64_t v = 0;
+	for (int i = 3; i >= 0; --i) {
+		v = (v << 8) | static_cast<unsigned char>(p[i]);
+	}
+	return v;
+}
+
+inline uint64_t WyHash::LoadReader::Read8(const char* p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+#else
+	return ByteReader::Read8(p);
+#endif
+}
+
+inline uint64_t WyHash::LoadReader::Read4(const char* p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+#else
+	return ByteReader::Read4(p);
+#endif
+}
+
+template <class Reader>
+constexpr uint64_t WyHash::Hash(const char* p, size_t len, uint64_t seed) {
+	seed ^= Mix(seed ^ kSecret[0], kSecret[1]);
+	uint64_t a = 0;
+	uint64_t b = 0;
+	if (len <= 16) {
+		if (len >= 4) {
+			a = (Reader::Read4(p) << 32) | Reader::Read4(p + ((len >> 3) << 2));
+			b = (Reader::Read4(p + len - 4) << 32) | Reader::Read4(p + len - 4 - ((len >> 3) << 2));
+		} else if (len > 0) {
+			a = (uint64_t(static_cast<unsigned char>(p[0])) << 16) |
+				(uint64_t(static_cast<unsigned char>(p[len >> 1])) << 8) | static_cast<unsigned char>(p[len - 1]);
+		}
+	} else {
+		size_t i = len;
+		if (i > 48) {
+			uint64_t see1 = seed;
+			uint64_t see2 = seed;
+			do {
+				seed = Mix(Reader::Read8(p) ^ kSecret[1], Reader::Read8(p + 8) ^ seed);
+				see1 = Mix(Reader::Read8(p + 16) ^ kSecret[2], Reader::Read8(p + 24) ^ see1);
+				see2 = Mix(Reader::Read8(p + 32) ^ kSecret[3], Reader::Read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while (i > 16) {
+			seed = Mix(Reader::Read8(p) ^ kSecret[1], Reader::Read8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = Reader::Read8(p + i - 16);
+		b = Reader::Read8(p + i - 8);
+	}
+	a ^= kSecret[1];
+	b ^= seed;
+	Mum(a, b);
+	return Mix(a ^ kSecret[0] ^ len, b ^ kSecret[1]);
+}
+
+inline uint64_t HashString(StringView str, uint64_t seed = 0) {
+	return WyHash::Hash<WyHash::LoadReader>(str.Data(), str.Size(), seed);
+}
+
+// Named apart from ConstHashString so that ConstHashString("abc", 7) cannot
+// resolve to a 7-byte read of "abc".
+constexpr uint64_t ConstHashBytes(const char* data, size_t size, uint64_t seed = 0) {
+	return WyHash::Hash<WyHash::ByteReader>(data, size, seed);
+}
+
+template <size_t N>
+constexpr uint64_t ConstHashString(const char (&str)[N], uint64_t seed = 0) {
+	return ConstHashBytes(str, N - 1, seed);
+}
+
+// Hasher for unordered containers keyed by StringView.
+struct StringViewHash {
+	size_t operator()(StringView str) const {
+		return static_cast<size_t>(HashString(str));
+	}
+};
+
+#endif
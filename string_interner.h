@@ -0,0 +1,327 @@
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include "string_hash.h"
+#include "string_view.h"
+#include "vector.h"
+
+// Stores each distinct string once and hands out stable StringViews and
+// dense ids (0, 1, 2, ... in order of first insertion). String bytes are
+// packed into arena blocks that are never moved or freed before the
+// interner, so returned views stay valid for its lifetime. Lookup is an
+// open-addressing table of (hash, id) slots with linear probing.
+class StringInterner {
+	struct Slot {
+		uint64_t hash_;
+		uint32_t id_;
+	};
+
+	const static uint32_t kEmpty = UINT32_MAX;
+	const static size_t kMinCapacity = 16;
+	const static size_t kBlockSize = 64 * 1024;
+
+	Slot* slots_;
+	size_t capacity_;
+	Vector<StringView> strings_;
+	Vector<char*> blocks_;
+	char* block_pos_;
+	size_t block_left_;
+	size_t bytes_;
+
+	const char* Store(StringView str);
+	void Rehash(size_t new_cap);
+	size_t Probe(StringView str, uint64_t hash) const;
+
+public:
+	const static uint32_t kNotFound = UINT32_MAX;
+
+	StringInterner();
+	StringInterner(const StringInterner& other) = delete;
+	StringInterner& operator=(const StringInterner& other) = delete;
+	~StringInterner();
+
+	uint32_t Intern(StringView str);
+	uint32_t Intern(StringView str, uint64_t hash);
+	StringView InternView(StringView str);
+	uint32_t Find(StringView str) const;
+	uint32_t Find(StringView str, uint64_t hash) const;
+	StringView Get(uint32_t id) const;
+	size_t Size() const;
+	size_t MemoryUsage() const;
+};
+
+inline StringInterner::StringInterner() :
+slots_(nullptr), capacity_(0), block_pos_(nullptr), block_left_(0), bytes_(0) {
+	Rehash(kMinCapacity);
+}
+
+inline StringInterner::~StringInterner() {
+	delete[] slots_;
+	for (size_t i = 0; i < blocks_.Size(); ++i) {
+		delete[] blocks_[i];
+	}
+}
+
+inline const char* StringInterner::Store(StringView str) {
+	if (str.Size() > block_left_) {
+		const size_t size = str.Size() > kBlockSize / 4 ? str.Size() : kBlockSize;
+		char* block = new char[size];
+		blocks_.PushBack(block);
+		bytes_ += size;
+		if (size != kBlockSize) {
+			memcpy(block, str.Data(), str.Size());
+			return block;
+		}
+		block_pos_ = block;
+		block_left_ = size;
+	}
+	char* dst = block_pos_;
+	if (!str.Empty()) {
+		memcpy(dst, str.Data(), str.Size());
+	}
+	block_pos_ += str.Size();
+	block_left_ -= str.Size();
+	return dst;
+}
+
+inline void StringInterner::Rehash(size_t new_cap) {
+	Slot* new_slots = new Slot[new_cap];
+	for (size_t i = 0; i < new_cap; ++i) {
+		new_slots[i].id_ = kEmpty;
+	}
+	for (size_t i = 0; i < capacity_; ++i) {
+		if (slots_[i].id_ == kEmpty) {
+			continue;
+		}
+		size_t pos = slots_[i].hash_ & (new_cap - 1);
+		while (new_slots[pos].id_ != kEmpty) {
+			pos = (pos + 1) & (new_cap - 1);
+		}
+		new_slots[pos] = slots_[i];
+	}
+	delete[] slots_;
+	slots_ = new_slots;
+	capacity_ = new_cap;
+}
+
+inline size_t StringInterner::Probe(StringView str, uint64_t hash) const {
+	size_t pos = hash & (capacity_ - 1);
+	while (true) {
+		const Slot& slot = slots_[pos];
+		if (slot.id_ == kEmpty) {
+			return pos;
+		}
+		if (slot.hash_ == hash) {
+			const StringView stored = strings_[slot.id_];
+			if (stored.Size() == str.Size() && (str.Empty() || memcmp(stored.Data(), str.Data(), str.Size()) == 0)) {
+				return pos;
+			}
+		}
+		pos = (pos + 1) & (capacity_ - 1);
+	}
+}
+
+inline uint32_t StringInterner::Intern(StringView str) {
+	return Intern(str, HashString(str));
+}
+
+inline uint32_t StringInterner::Intern(StringView str, uint64_t hash) {
+	size_t pos = Probe(str, hash);
+	if (slots_[pos].id_ != kEmpty) {
+		return slots_[pos].id_;
+	}
+	if ((strings_.Size() + 1) * 4 > capacity_ * 3) {
+		Rehash(capacity_ * 2);
+		pos = Probe(str, hash);
+	}
+	const uint32_t id = static_cast<uint32_t>(strings_.Size());
+	strings_.PushBack(StringView(Store(str), str.Size()));
+	slots_[pos].hash_ = hash;
+	slots_[pos].id_ = id;
+	return id;
+}
+
+inline StringView StringInterner::InternView(StringView str) {
+	return strings_[Intern(str)];
+}
+
+inline uint32_t StringInterner::Find(StringView str) const {
+	return Find(str, HashString(str));
+}
+
+inline uint32_t StringInterner::Find(StringView str, uint64_t hash) const {
+	const Slot& slot = slots_[Probe(str, hash)];
+	return slot.id_ == kEmpty ? kNotFound : slot.id_;
+}
+
+inline StringView StringInterner::Get(uint32_t id) const {
+	return strings_[id];
+}
+
+inline size_t StringInterner::Size() const {
+	return strings_.Size();
+}
+
+inline size_t StringInterner::MemoryUsage() const {
+	return bytes_ + capacity_ * sizeof(Slot) + strings_.Capacity() * sizeof(StringView) +
+		   blocks_.Capacity() * sizeof(char*);
+}
+
+// Thread-safe interner split into shards by hash, each behind a
+// reader-writer lock; lookups of strings that are already interned take only
+// the shared lock. Ids are dense like StringInterner's, drawn from one atomic
+// counter when a shard inserts a string; each shard maps its local ids to
+// global ones, and Get reads a lock-free id -> string table kept in chunks that
+// double in size and are never moved. Interning more than kNotFound distinct
+// strings throws std::length_error.
+class ConcurrentStringInterner {
+	const static size_t kShardBits = 4;
+	const static size_t kShards = size_t(1) << kShardBits;
+	const static size_t kFirstChunkBits = 10;
+	const static size_t kChunks = 33 - kFirstChunkBits;
+
+	struct alignas(64) Shard {
+		mutable std::shared_mutex mutex_;
+		StringInterner interner_;
+		Vector<uint32_t> ids_;
+	};
+
+	Shard shards_[kShards];
+	std::atomic<StringView*> chunks_[kChunks];
+	std::atomic<uint64_t> next_id_;
+
+	static size_t ShardOf(uint64_t hash);
+	static size_t ChunkOf(uint32_t id, size_t* offset);
+	void Publish(uint32_t id, StringView str);
+
+public:
+	const static uint32_t kNotFound = StringInterner::kNotFound;
+
+	ConcurrentStringInterner();
+	ConcurrentStringInterner(const ConcurrentStringInterner& other) = delete;
+	ConcurrentStringInterner& operator=(const ConcurrentStringInterner& other) = delete;
+	~ConcurrentStringInterner();
+
+	uint32_t Intern(StringView str);
+	StringView InternView(StringView str);
+	uint32_t Find(StringView str) const;
+	StringView Get(uint32_t id) const;
+	size_t Size() const;
+	size_t MemoryUsage() const;
+};
+
+inline ConcurrentStringInterner::ConcurrentStringInterner() : next_id_(0) {
+	for (size_t i = 0; i < kChunks; ++i) {
+		chunks_[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+inline ConcurrentStringInterner::~ConcurrentStringInterner() {
+	for (size_t i = 0; i < kChunks; ++i) {
+		delete[] chunks_[i].load(std::memory_order_relaxed);
+	}
+}
+
+inline size_t ConcurrentStringInterner::ShardOf(uint64_t hash) {
+	return hash >> (64 - kShardBits);
+}
+
+// Chunk i holds 2^(kFirstChunkBits + i) ids, starting at 2^kFirstChunkBits * (2^i - 1).
+inline size_t ConcurrentStringInterner::ChunkOf(uint32_t id, size_t* offset) {
+	const uint64_t pos = uint64_t(id) + (uint64_t(1) << kFirstChunkBits);
+	const size_t bit = 63 - __builtin_clzll(pos);
+	*offset = pos - (uint64_t(1) << bit);
+	return bit - kFirstChunkBits;
+}
+
+// Called under the lock of the shard that owns id; readers learn the id only
+// through that lock or from a thread that did.
+inline void ConcurrentStringInterner::Publish(uint32_t id, StringView str) {
+	size_t offset;
+	const size_t chunk_idx = ChunkOf(id, &offset);
+	StringView* chunk = chunks_[chunk_idx].load(std::memory_order_acquire);
+	if (chunk == nullptr) {
+		StringView* fresh = new StringView[size_t(1) << (kFirstChunkBits + chunk_idx)];
+		if (chunks_[chunk_idx].compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel)) {
+			chunk = fresh;
+		} else {
+			delete[] fresh;
+		}
+	}
+	chunk[offset] = str;
+}
+
+inline uint32_t ConcurrentStringInterner::Intern(StringView str) {
+	const uint64_t hash = HashString(str);
+	Shard& shard = shards_[ShardOf(hash)];
+	{
+		std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+		const uint32_t local = shard.interner_.Find(str, hash);
+		if (local != kNotFound) {
+			return shard.ids_[local];
+		}
+	}
+	std::unique_lock<std::shared_mutex> lock(shard.mutex_);
+	const uint32_t local = shard.interner_.Find(str, hash);
+	if (local != kNotFound) {
+		return shard.ids_[local];
+	}
+	const uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+	if (id >= kNotFound) {
+		throw std::length_error("ConcurrentStringInterner: too many strings");
+	}
+	const StringView stored = shard.interner_.Get(shard.interner_.Intern(str, hash));
+	shard.ids_.PushBack(static_cast<uint32_t>(id));
+	Publish(static_cast<uint32_t>(id), stored);
+	return static_cast<uint32_t>(id);
+}
+
+inline StringView ConcurrentStringInterner::InternView(StringView str) {
+	return Get(Intern(str));
+}
+
+inline uint32_t ConcurrentStringInterner::Find(StringView str) const {
+	const uint64_t hash = HashString(str);
+	const Shard& shard = shards_[ShardOf(hash)];
+	std::shared_lock<std::shared_mutex> lock(shard.mutex_);
+	const uint32_t local = shard.interner_.Find(str, hash);
+	return local == kNotFound ? kNotFound : shard.ids_[local];
+}
+
+inline StringView ConcurrentStringInterner::Get(uint32_t id) const {
+	size_t offset;
+	const size_t chunk_idx = ChunkOf(id, &offset);
+	return chunks_[chunk_idx].load(std::memory_order_acquire)[offset];
+}
+
+inline size_t ConcurrentStringInterner::Size() const {
+	size_t size = 0;
+	for (size_t i = 0; i < kShards; ++i) {
+		std::shared_lock<std::shared_mutex> lock(shards_[i].mutex_);
+		size += shards_[i].interner_.Size();
+	}
+	return size;
+}
+
+inline size_t ConcurrentStringInterner::MemoryUsage() const {
+	size_t bytes = 0;
+	for (size_t i = 0; i < kShards; ++i) {
+		std::shared_lock<std::shared_mutex> lock(shards_[i].mutex_);
+		bytes += shards_[i].interner_.MemoryUsage() + shards_[i].ids_.Capacity() * sizeof(uint32_t);
+	}
+	for (size_t i = 0; i < kChunks; ++i) {
+		if (chunks_[i].load(std::memory_order_relaxed) != nullptr) {
+			bytes += (size_t(1) << (kFirstChunkBits + i)) * sizeof(StringView);
+		}
+	}
+	return bytes;
+}
+
+#endif
@@ -0,0 +1,427 @@
+#ifndef STRING_SEARCH_H
+#define STRING_SEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && defined(__SSE2__)
+#define STRING_SEARCH_X86 1
+#include <immintrin.h>
+#define STRING_SEARCH_AVX2 __attribute__((target("avx2")))
+#else
+#define STRING_SEARCH_X86 0
+#endif
+
+// Byte search kernels behind StringView. Each operation has a scalar, an SSE2
+// and an AVX2 version; the widest one the CPU supports is picked once at
+// first use. Results are offsets into data, or kNpos.
+class StringSearch {
+	struct Kernels {
+		size_t (*find_char_)(const char* data, size_t size, char c);
+		size_t (*rfind_char_)(const char* data, size_t size, char c);
+		size_t (*count_char_)(const char* data, size_t size, char c);
+		size_t (*find_)(const char* data, size_t size, const char* needle, size_t needle_size);
+		size_t (*find_first_of_)(const char* data, size_t size, const char* set, size_t set_size, bool matching);
+	};
+
+	// Sets with at most this many bytes are matched with one vector compare per
+	// byte; larger sets use a 256-bit lookup table.
+	const static size_t kMaxVectorSet = 16;
+
+	static const Kernels& Select();
+
+	static size_t FindCharScalar(const char* data, size_t size, char c);
+	static size_t RFindCharScalar(const char* data, size_t size, char c);
+	static size_t CountCharScalar(const char* data, size_t size, char c);
+	static size_t FindScalar(const char* data, size_t size, const char* needle, size_t needle_size);
+	static size_t FindFirstOfScalar(const char* data, size_t size, const char* set, size_t set_size, bool matching);
+	static size_t FindFirstOfTable(const char* data, size_t size, const char* set, size_t set_size, bool matching);
+	static char FoldCase(char c);
+	static bool EqualIgnoreCaseScalar(const char* a, const char* b, size_t size);
+
+#if STRING_SEARCH_X86
+	static size_t FindCharSse2(const char* data, size_t size, char c);
+	static size_t RFindCharSse2(const char* data, size_t size, char c);
+	static size_t CountCharSse2(const char* data, size_t size, char c);
+	static size_t FindSse2(const char* data, size_t size, const char* needle, size_t needle_size);
+	static size_t FindFirstOfSse2(const char* data, size_t size, const char* set, size_t set_size, bool matching);
+	static __m128i FoldCaseSse2(__m128i block);
+	static bool EqualIgnoreCaseSse2(const char* a, const char* b, size_t size);
+	STRING_SEARCH_AVX2 static size_t FindCharAvx2(const char* data, size_t size, char c);
+	STRING_SEARCH_AVX2 static size_t RFindCharAvx2(const char* data, size_t size, char c);
+	STRING_SEARCH_AVX2 static size_t CountCharAvx2(const char* data, size_t size, char c);
+	STRING_SEARCH_AVX2 static size_t FindAvx2(const char* data, size_t size, const char* needle, size_t needle_size);
+	STRING_SEARCH_AVX2 static size_t FindFirstOfAvx2(const char* data, size_t size, const char* set, size_t set_size, bool matching);
+#endif
+
+public:
+	const static size_t kNpos = static_cast<size_t>(-1);
+
+	static size_t FindChar(const char* data, size_t size, char c);
+	static size_t RFindChar(const char* data, size_t size, char c);
+	static size_t CountChar(const char* data, size_t size, char c);
+	static size_t Find(const char* data, size_t size, const char* needle, size_t needle_size);
+	static size_t RFind(const char* data, size_t size, const char* needle, size_t needle_size);
+	static size_t FindFirstOf(const char* data, size_t size, const char* set, size_t set_size);
+	static size_t FindFirstNotOf(const char* data, size_t size, const char* set, size_t set_size);
+	// ASCII case-insensitive equality of two ranges of the same size. SSE2 is
+	// part of the x86-64 baseline, so this is not dispatched at runtime.
+	static bool EqualIgnoreCase(const char* a, const char* b, size_t size);
+};
+
+inline const StringSearch::Kernels& StringSearch::Select() {
+	static const Kernels kernels = [] {
+#if STRING_SEARCH_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			return Kernels{&FindCharAvx2, &RFindCharAvx2, &CountCharAvx2, &FindAvx2, &FindFirstOfAvx2};
+		}
+		return Kernels{&FindCharSse2, &RFindCharSse2, &CountCharSse2, &FindSse2, &FindFirstOfSse2};
+#else
+		return Kernels{&FindCharScalar, &RFindCharScalar, &CountCharScalar, &FindScalar, &FindFirstOfScalar};
+#endif
+	}();
+	return kernels;
+}
+
+inline size_t StringSearch::FindChar(const char* data, size_t size, char c) {
+	return Select().find_char_(data, size, c);
+}
+
+inline size_t StringSearch::RFindChar(const char* data, size_t size, char c) {
+	return Select().rfind_char_(data, size, c);
+}
+
+inline size_t StringSearch::CountChar(const char* data, size_t size, char c) {
+	return Select().count_char_(data, size, c);
+}
+
+inline size_t StringSearch::Find(const char* data, size_t size, const char* needle, size_t needle_size) {
+	if (needle_size == 0) {
+		return 0;
+	}
+	if (needle_size > size) {
+		return kNpos;
+	}
+	if (needle_size == 1) {
+		return FindChar(data, size, needle[0]);
+	}
+	return Select().find_(data, size, needle, needle_size);
+}
+
+inline size_t StringSearch::RFind(const char* data, size_t size, const char* needle, size_t needle_size) {
+	if (needle_size > size) {
+		return kNpos;
+	}
+	if (needle_size == 0) {
+		return size;
+	}
+	size_t end = size - needle_size + 1;
+	while (end > 0) {
+		const size_t pos = RFindChar(data, end, needle[0]);
+		if (pos == kNpos) {
+			return kNpos;
+		}
+		if (memcmp(data + pos + 1, needle + 1, needle_size - 1) == 0) {
+			return pos;
+		}
+		end = pos;
+	}
+	return kNpos;
+}
+
+inline size_t StringSearch::FindFirstOf(const char* data, size_t size, const char* set, size_t set_size) {
+	if (set_size == 0) {
+		return kNpos;
+	}
+	if (set_size == 1) {
+		return FindChar(data, size, set[0]);
+	}
+	return Select().find_first_of_(data, size, set, set_size, true);
+}
+
+inline size_t StringSearch::FindFirstNotOf(const char* data, size_t size, const char* set, size_t set_size) {
+	if (set_size == 0) {
+		return size == 0 ? kNpos : 0;
+	}
+	return Select().find_first_of_(data, size, set, set_size, false);
+}
+
+inline bool StringSearch::EqualIgnoreCase(const char* a, const char* b, size_t size) {
+#if STRING_SEARCH_X86
+	return EqualIgnoreCaseSse2(a, b, size);
+#else
+	return EqualIgnoreCaseScalar(a, b, size);
+#endif
+}
+
+inline size_t StringSearch::FindCharScalar(const char* data, size_t size, char c) {
+	const void* found = size == 0 ? nullptr : memchr(data, c, size);
+	return found == nullptr ? kNpos : static_cast<const char*>(found) - data;
+}
+
+inline size_t StringSearch::RFindCharScalar(const char* data, size_t size, char c) {
+	for (size_t i = size; i > 0; --i) {
+		if (data[i - 1] == c) {
+			return i - 1;
+		}
+	}
+	return kNpos;
+}
+
+inline size_t StringSearch::CountCharScalar(const char* data, size_t size, char c) {
+	size_t count = 0;
+	for (size_t i = 0; i < size; ++i) {
+		count += data[i] == c;
+	}
+	return count;
+}
+
+inline size_t StringSearch::FindScalar(const char* data, size_t size, const char* needle, size_t needle_size) {
+	if (needle_size > size) {
+		return kNpos;
+	}
+	const size_t last = size - needle_size;
+	size_t pos = 0;
+	while (pos <= last) {
+		const size_t found = FindCharScalar(data + pos, last - pos + 1, needle[0]);
+		if (found == kNpos) {
+			return kNpos;
+		}
+		pos += found;
+		if (data[pos + needle_size - 1] == needle[needle_size - 1] &&
+			memcmp(data + pos + 1, needle + 1, needle_size - 2) == 0) {
+			return pos;
+		}
+		++pos;
+	}
+	return kNpos;
+}
+
+inline size_t StringSearch::FindFirstOfTable(const char* data, size_t size, const char* set, size_t set_size, bool matching) {
+	uint64_t table[4] = {0, 0, 0, 0};
+	for (size_t i = 0; i < set_size; ++i) {
+		const unsigned char c = static_cast<unsigned char>(set[i]);
+		table[c >> 6] |= uint64_t(1) << (c & 63);
+	}
+	for (size_t i = 0; i < size; ++i) {
+		const unsigned char c = static_cast<unsigned char>(data[i]);
+		if (((table[c >> 6] >> (c & 63)) & 1) == static_cast<uint64_t>(matching)) {
+			return i;
+		}
+	}
+	return kNpos;
+}
+
+inline size_t StringSearch::FindFirstOfScalar(const char* data, size_t size, const char* set, size_t set_size, bool matching) {
+	return FindFirstOfTable(data, size, set, set_size, matching);
+}
+
+inline char StringSearch::FoldCase(char c) {
+	return static_cast<unsigned char>(c - 'A') < 26 ? static_cast<char>(c | 0x20) : c;
+}
+
+inline bool StringSearch::EqualIgnoreCaseScalar(const char* a, const char* b, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		if (FoldCase(a[i]) != FoldCase(b[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#if STRING_SEARCH_X86
+
+inline __m128i StringSearch::FoldCaseSse2(__m128i block) {
+	const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)),
+										_mm_cmplt_epi8(block, _mm_set1_epi8('Z' + 1)));
+	return _mm_or_si128(block, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+inline bool StringSearch::EqualIgnoreCaseSse2(const char* a, const char* b, size_t size) {
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i lhs = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+		const __m128i rhs = FoldCaseSse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(lhs, rhs)) != 0xFFFF) {
+			return false;
+		}
+	}
+	return EqualIgnoreCaseScalar(a + i, b + i, size - i);
+}
+
+inline size_t StringSearch::FindCharSse2(const char* data, size_t size, char c) {
+	const __m128i pattern = _mm_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	for (; i < size; ++i) {
+		if (data[i] == c) {
+			return i;
+		}
+	}
+	return kNpos;
+}
+
+inline size_t StringSearch::RFindCharSse2(const char* data, size_t size, char c) {
+	const __m128i pattern = _mm_set1_epi8(c);
+	size_t i = size;
+	for (; i >= 16; i -= 16) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i - 16));
+		const unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+		if (mask != 0) {
+			return i - 16 + 31 - __builtin_clz(mask);
+		}
+	}
+	return RFindCharScalar(data, i, c);
+}
+
+inline size_t StringSearch::CountCharSse2(const char* data, size_t size, char c) {
+	const __m128i pattern = _mm_set1_epi8(c);
+	size_t count = 0;
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)));
+	}
+	return count + CountCharScalar(data + i, size - i, c);
+}
+
+inline size_t StringSearch::FindSse2(const char* data, size_t size, const char* needle, size_t needle_size) {
+	const __m128i first = _mm_set1_epi8(needle[0]);
+	const __m128i last = _mm_set1_epi8(needle[needle_size - 1]);
+	size_t i = 0;
+	for (; i + needle_size - 1 + 16 <= size; i += 16) {
+		const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + needle_size - 1));
+		unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first), _mm_cmpeq_epi8(block_last, last)));
+		while (mask != 0) {
+			const size_t pos = i + __builtin_ctz(mask);
+			if (memcmp(data + pos + 1, needle + 1, needle_size - 2) == 0) {
+				return pos;
+			}
+			mask &= mask - 1;
+		}
+	}
+	const size_t found = FindScalar(data + i, size - i, needle, needle_size);
+	return found == kNpos ? kNpos : i + found;
+}
+
+inline size_t StringSearch::FindFirstOfSse2(const char* data, size_t size, const char* set, size_t set_size, bool matching) {
+	if (set_size > kMaxVectorSet) {
+		return FindFirstOfTable(data, size, set, set_size, matching);
+	}
+	__m128i patterns[kMaxVectorSet];
+	for (size_t j = 0; j < set_size; ++j) {
+		patterns[j] = _mm_set1_epi8(set[j]);
+	}
+	const unsigned flip = matching ? 0 : 0xFFFF;
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i hits = _mm_cmpeq_epi8(block, patterns[0]);
+		for (size_t j = 1; j < set_size; ++j) {
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, patterns[j]));
+		}
+		const unsigned mask = _mm_movemask_epi8(hits) ^ flip;
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	const size_t found = FindFirstOfTable(data + i, size - i, set, set_size, matching);
+	return found == kNpos ? kNpos : i + found;
+}
+
+STRING_SEARCH_AVX2 inline size_t StringSearch::FindCharAvx2(const char* data, size_t size, char c) {
+	const __m256i pattern = _mm256_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern));
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	const size_t found = FindCharSse2(data + i, size - i, c);
+	return found == kNpos ? kNpos : i + found;
+}
+
+STRING_SEARCH_AVX2 inline size_t StringSearch::RFindCharAvx2(const char* data, size_t size, char c) {
+	const __m256i pattern = _mm256_set1_epi8(c);
+	size_t i = size;
+	for (; i >= 32; i -= 32) {
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i - 32));
+		const unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern));
+		if (mask != 0) {
+			return i - 32 + 31 - __builtin_clz(mask);
+		}
+	}
+	return RFindCharSse2(data, i, c);
+}
+
+STRING_SEARCH_AVX2 inline size_t StringSearch::CountCharAvx2(const char* data, size_t size, char c) {
+	const __m256i pattern = _mm256_set1_epi8(c);
+	size_t count = 0;
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		count += __builtin_popcount(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern)));
+	}
+	return count + CountCharSse2(data + i, size - i, c);
+}
+
+STRING_SEARCH_AVX2 inline size_t StringSearch::FindAvx2(const char* data, size_t size, const char* needle, size_t needle_size) {
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[needle_size - 1]);
+	size_t i = 0;
+	for (; i + needle_size - 1 + 32 <= size; i += 32) {
+		const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + needle_size - 1));
+		unsigned mask = _mm256_movemask_epi8(
+			_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first), _mm256_cmpeq_epi8(block_last, last)));
+		while (mask != 0) {
+			const size_t pos = i + __builtin_ctz(mask);
+			if (memcmp(data + pos + 1, needle + 1, needle_size - 2) == 0) {
+				return pos;
+			}
+			mask &= mask - 1;
+		}
+	}
+	const size_t found = FindSse2(data + i, size - i, needle, needle_size);
+	return found == kNpos ? kNpos : i + found;
+}
+
+STRING_SEARCH_AVX2 inline size_t StringSearch::FindFirstOfAvx2(const char* data, size_t size, const char* set, size_t set_size, bool matching) {
+	if (set_size > kMaxVectorSet) {
+		return FindFirstOfTable(data, size, set, set_size, matching);
+	}
+	__m256i patterns[kMaxVectorSet];
+	for (size_t j = 0; j < set_size; ++j) {
+		patterns[j] = _mm256_set1_epi8(set[j]);
+	}
+	const unsigned flip = matching ? 0 : 0xFFFFFFFFu;
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		__m256i hits = _mm256_cmpeq_epi8(block, patterns[0]);
+		for (size_t j = 1; j < set_size; ++j) {
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, patterns[j]));
+		}
+		const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits)) ^ flip;
+		if (mask != 0) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	const size_t found = FindFirstOfSse2(data + i, size - i, set, set_size, matching);
+	return found == kNpos ? kNpos : i + found;
+}
+
+#endif
+
+#endif
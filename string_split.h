@@ -0,0 +1,297 @@
+#ifndef STRING_SPLIT_H
+#define STRING_SPLIT_H
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include "string_view.h"
+
+// Lazy ranges of StringView fields pointing into the split text; nothing is
+// copied or allocated. A Delimiter finds the next separator at or after pos
+// and returns its offset and length ({kNpos, 0} if there is none), and may
+// adjust the field before it is yielded.
+template <class Delimiter>
+class SplitRange {
+	StringView text_;
+	Delimiter delimiter_;
+
+public:
+	class Iterator {
+		const SplitRange* range_;
+		StringView field_;
+		size_t next_;
+		bool end_;
+
+		void Advance();
+
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef StringView value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const StringView* pointer;
+		typedef const StringView& reference;
+
+		Iterator();
+		explicit Iterator(const SplitRange* range);
+
+		const StringView& operator*() const;
+		const StringView* operator->() const;
+		Iterator& operator++();
+		Iterator operator++(int);
+		bool operator==(const Iterator& other) const;
+		bool operator!=(const Iterator& other) const;
+	};
+
+	SplitRange(StringView text, Delimiter delimiter);
+
+	Iterator begin() const;
+	Iterator end() const;
+};
+
+struct CharDelimiter {
+	char c_;
+
+	const static bool kSkipTrailingEmpty = false;
+	std::pair<size_t, size_t> Find(StringView text, size_t pos) const;
+	StringView Adjust(StringView field) const;
+};
+
+// An empty separator never matches, so the whole text is one field.
+struct StringDelimiter {
+	StringView sep_;
+
+	const static bool kSkipTrailingEmpty = false;
+	std::pair<size_t, size_t> Find(StringView text, size_t pos) const;
+	StringView Adjust(StringView field) const;
+};
+
+struct AnyCharDelimiter {
+	StringView chars_;
+
+	const static bool kSkipTrailingEmpty = false;
+	std::pair<size_t, size_t> Find(StringView text, size_t pos) const;
+	StringView Adjust(StringView field) const;
+};
+
+// Splits on '\n', drops a trailing '\r' and does not yield an empty line
+// after a final newline.
+struct LineDelimiter {
+	const static bool kSkipTrailingEmpty = true;
+	std::pair<size_t, size_t> Find(StringView text, size_t pos) const;
+	StringView Adjust(StringView field) const;
+};
+
+// RFC 4180 fields of one record: commas inside double quotes do not split,
+// and the enclosing quotes are removed. Doubled quotes inside a quoted field
+// are left as they are, since unescaping would need a copy.
+struct CsvFieldDelimiter {
+	const static bool kSkipTrailingEmpty = false;
+	std::pair<size_t, size_t> Find(StringView text, size_t pos) const;
+	StringView Adjust(StringView field) const;
+};
+
+// Records of a CSV buffer: like LineDelimiter, but newlines inside quoted
+// fields do not end the record.
+struct CsvRecordDelimiter {
+	const static bool kSkipTrailingEmpty = true;
+	std::pair<size_t, size_t> Find(StringView text, size_t pos) const;
+	StringView Adjust(StringView field) const;
+};
+
+SplitRange<CharDelimiter> Split(StringView text, char sep);
+SplitRange<StringDelimiter> Split(StringView text, StringView sep);
+SplitRange<AnyCharDelimiter> SplitAny(StringView text, StringView chars);
+SplitRange<LineDelimiter> Lines(StringView text);
+SplitRange<CsvFieldDelimiter> CsvFields(StringView record);
+SplitRange<CsvRecordDelimiter> CsvRecords(StringView text);
+
+template <class Delimiter>
+SplitRange<Delimiter>::SplitRange(StringView text, Delimiter delimiter) : text_(text), delimiter_(delimiter) {
+}
+
+template <class Delimiter>
+typename SplitRange<Delimiter>::Iterator SplitRange<Delimiter>::begin() const {
+	return Iterator(this);
+}
+
+template <class Delimiter>
+typename SplitRange<Delimiter>::Iterator SplitRange<Delimiter>::end() const {
+	return Iterator();
+}
+
+template <class Delimiter>
+SplitRange<Delimiter>::Iterator::Iterator() : range_(nullptr), next_(StringView::kNpos), end_(true) {
+}
+
+template <class Delimiter>
+SplitRange<Delimiter>::Iterator::Iterator(const SplitRange* range) : range_(range), next_(0), end_(false) {
+	if (Delimiter::kSkipTrailingEmpty && range_->text_.Empty()) {
+		end_ = true;
+		return;
+	}
+	Advance();
+}
+
+template <class Delimiter>
+void SplitRange<Delimiter>::Iterator::Advance() {
+	if (next_ == StringView::kNpos) {
+		end_ = true;
+		return;
+	}
+	const StringView& text = range_->text_;
+	const std::pair<size_t, size_t> delim = range_->delimiter_.Find(text, next_);
+	if (delim.first == StringView::kNpos) {
+		field_ = StringView(text.Data() + next_, text.Size() - next_);
+		next_ = StringView::kNpos;
+	} else {
+		field_ = StringView(text.Data() + next_, delim.first - next_);
+		next_ = delim.first + delim.second;
+		if (Delimiter::kSkipTrailingEmpty && next_ == text.Size()) {
+			next_ = StringView::kNpos;
+		}
+	}
+	field_ = range_->delimiter_.Adjust(field_);
+}
+
+template <class Delimiter>
+const StringView& SplitRange<Delimiter>::Iterator::operator*() const {
+	return field_;
+}
+
+template <class Delimiter>
+const StringView* SplitRange<Delimiter>::Iterator::operator->() const {
+	return &field_;
+}
+
+template <class Delimiter>
+typename SplitRange<Delimiter>::Iterator& SplitRange<Delimiter>::Iterator::operator++() {
+	Advance();
+	return *this;
+}
+
+template <class Delimiter>
+typename SplitRange<Delimiter>::Iterator SplitRange<Delimiter>::Iterator::operator++(int) {
+	Iterator copy = *this;
+	Advance();
+	return copy;
+}
+
+template <class Delimiter>
+bool SplitRange<Delimiter>::Iterator::operator==(const Iterator& other) const {
+	if (end_ || other.end_) {
+		return end_ == other.end_;
+	}
+	return range_ == other.range_ && field_.Data() == other.field_.Data();
+}
+
+template <class Delimiter>
+bool SplitRange<Delimiter>::Iterator::operator!=(const Iterator& other) const {
+	return !(*this == other);
+}
+
+inline std::pair<size_t, size_t> CharDelimiter::Find(StringView text, size_t pos) const {
+	return std::make_pair(text.Find(c_, pos), size_t(1));
+}
+
+inline StringView CharDelimiter::Adjust(StringView field) const {
+	return field;
+}
+
+inline std::pair<size_t, size_t> StringDelimiter::Find(StringView text, size_t pos) const {
+	if (sep_.Empty()) {
+		return std::make_pair(StringView::kNpos, size_t(0));
+	}
+	return std::make_pair(text.Find(sep_, pos), sep_.Size());
+}
+
+inline StringView StringDelimiter::Adjust(StringView field) const {
+	return field;
+}
+
+inline std::pair<size_t, size_t> AnyCharDelimiter::Find(StringView text, size_t pos) const {
+	return std::make_pair(text.FindFirstOf(chars_, pos), size_t(1));
+}
+
+inline StringView AnyCharDelimiter::Adjust(StringView field) const {
+	return field;
+}
+
+inline std::pair<size_t, size_t> LineDelimiter::Find(StringView text, size_t pos) const {
+	return std::make_pair(text.Find('\n', pos), size_t(1));
+}
+
+inline StringView LineDelimiter::Adjust(StringView field) const {
+	if (!field.Empty() && field.Back() == '\r') {
+		field.RemoveSuffix(1);
+	}
+	return field;
+}
+
+inline std::pair<size_t, size_t> CsvFieldDelimiter::Find(StringView text, size_t pos) const {
+	while (true) {
+		pos = text.FindFirstOf(StringView(",\"", 2), pos);
+		if (pos == StringView::kNpos || text[pos] == ',') {
+			return std::make_pair(pos, size_t(1));
+		}
+		pos = text.Find('"', pos + 1);
+		if (pos == StringView::kNpos) {
+			return std::make_pair(StringView::kNpos, size_t(0));
+		}
+		++pos;
+	}
+}
+
+inline StringView CsvFieldDelimiter::Adjust(StringView field) const {
+	if (field.Size() >= 2 && field.Front() == '"' && field.Back() == '"') {
+		field.RemovePrefix(1);
+		field.RemoveSuffix(1);
+	}
+	return field;
+}
+
+inline std::pair<size_t, size_t> CsvRecordDelimiter::Find(StringView text, size_t pos) const {
+	while (true) {
+		pos = text.FindFirstOf(StringView("\n\"", 2), pos);
+		if (pos == StringView::kNpos || text[pos] == '\n') {
+			return std::make_pair(pos, size_t(1));
+		}
+		pos = text.Find('"', pos + 1);
+		if (pos == StringView::kNpos) {
+			return std::make_pair(StringView::kNpos, size_t(0));
+		}
+		++pos;
+	}
+}
+
+inline StringView CsvRecordDelimiter::Adjust(StringView field) const {
+	if (!field.Empty() && field.Back() == '\r') {
+		field.RemoveSuffix(1);
+	}
+	return field;
+}
+
+inline SplitRange<CharDelimiter> Split(StringView text, char sep) {
+	return SplitRange<CharDelimiter>(text, CharDelimiter{sep});
+}
+
+inline SplitRange<StringDelimiter> Split(StringView text, StringView sep) {
+	return SplitRange<StringDelimiter>(text, StringDelimiter{sep});
+}
+
+inline SplitRange<AnyCharDelimiter> SplitAny(StringView text, StringView chars) {
+	return SplitRange<AnyCharDelimiter>(text, AnyCharDelimiter{chars});
+}
+
+inline SplitRange<LineDelimiter> Lines(StringView text) {
+	return SplitRange<LineDelimiter>(text, LineDelimiter());
+}
+
+inline SplitRange<CsvFieldDelimiter> CsvFields(StringView record) {
+	return SplitRange<CsvFieldDelimiter>(record, CsvFieldDelimiter());
+}
+
+inline SplitRange<CsvRecordDelimiter> CsvRecords(StringView text) {
+	return SplitRange<CsvRecordDelimiter>(text, CsvRecordDelimiter());
+}
+
+#endif
@@ -1,8 +1,11 @@
 #ifndef STRING_VIEW_H
 #define STRING_VIEW_H
 
+#include <cstring>
 #include <ostream>
+#include <stdexcept>
 #include <utility>
+#include "string_search.h"
 
 
 class StringView {
@@ -12,22 +15,38 @@ class StringView {
 public:
     typedef const char* const_iterator;
     typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+    const static size_t kNpos = StringSearch::kNpos;
 	
-    StringView();
-    StringView(const char* str);
-    StringView(const char* str, size_t size);
-    char operator[](size_t index) const;
+    constexpr StringView();
+    constexpr StringView(const char* str);
+    constexpr StringView(const char* str, size_t size);
+    constexpr char operator[](size_t index) const;
     char At(int index) const;
-    char Front() const;
-    char Back() const;
-    size_t Size() const;
-    size_t Length() const;
-    bool Empty() const;
-    const char* Data() const;
+    constexpr char Front() const;
+    constexpr char Back() const;
+    constexpr size_t Size() const;
+    constexpr size_t Length() const;
+    constexpr bool Empty() const;
+    constexpr const char* Data() const;
     void Swap(StringView& other);
-    void RemovePrefix(size_t prefix_size);
-    void RemoveSuffix(size_t suffix_size);
-    const StringView Substr(size_t pos, size_t count = -1) const;
+    constexpr void RemovePrefix(size_t prefix_size);
+    constexpr void RemoveSuffix(size_t suffix_size);
+    constexpr const StringView Substr(size_t pos, size_t count = -1) const;
+    int Compare(StringView other) const;
+    bool StartsWith(char c) const;
+    bool StartsWith(StringView prefix) const;
+    bool EndsWith(char c) const;
+    bool EndsWith(StringView suffix) const;
+    bool EqualsIgnoreCase(StringView other) const;
+    size_t Find(char c, size_t pos = 0) const;
+    size_t Find(StringView str, size_t pos = 0) const;
+    size_t RFind(char c, size_t pos = kNpos) const;
+    size_t RFind(StringView str, size_t pos = kNpos) const;
+    size_t FindFirstOf(StringView set, size_t pos = 0) const;
+    size_t FindFirstNotOf(StringView set, size_t pos = 0) const;
+    bool Contains(char c) const;
+    bool Contains(StringView str) const;
+    size_t Count(char c) const;
     constexpr const_iterator begin() const {
         return const_iterator(str_);
     }
@@ -54,16 +73,23 @@ public:
     }
 };
 
-inline StringView::StringView() : str_(nullptr), size_(0) {
+bool operator==(StringView lhs, StringView rhs);
+bool operator!=(StringView lhs, StringView rhs);
+bool operator<(StringView lhs, StringView rhs);
+bool operator<=(StringView lhs, StringView rhs);
+bool operator>(StringView lhs, StringView rhs);
+bool operator>=(StringView lhs, StringView rhs);
+
+constexpr StringView::StringView() : str_(nullptr), size_(0) {
 }
 
-inline StringView::StringView(const char* str) : str_(str), size_(strlen(str)) {
+constexpr StringView::StringView(const char* str) : str_(str), size_(__builtin_strlen(str)) {
 }
 
-inline StringView::StringView(const char* str, size_t size) : str_(str), size_(size) {
+constexpr StringView::StringView(const char* str, size_t size) : str_(str), size_(size) {
 }
 
-inline char StringView::operator[](size_t index) const {
+constexpr char StringView::operator[](size_t index) const {
     return str_[index];
 }
 
@@ -74,19 +100,19 @@ inline char StringView::At(int index) const {
     return str_[index];
 }
 
-inline char StringView::Front() const {
+constexpr char StringView::Front() const {
     return str_[0];
 }
 
-inline char StringView::Back() const {
+constexpr char StringView::Back() const {
     return str_[size_ - 1];
 }
 
-inline size_t StringView::Size() const {
+constexpr size_t StringView::Size() const {
     return size_;
 }
 
-inline size_t StringView::Length() const {
+constexpr size_t StringView::Length() const {
     return size_;
 }
 
@@ -95,29 +121,143 @@ inline void StringView::Swap(StringView& other) {
     std::swap(size_, other.size_);
 }
 
-inline bool StringView::Empty() const {
+constexpr bool StringView::Empty() const {
     return size_ == 0;
 }
 
-inline void StringView::RemovePrefix(size_t prefix_size) {
+constexpr void StringView::RemovePrefix(size_t prefix_size) {
     str_ += prefix_size;
     size_ -= prefix_size;
 }
 
-inline void StringView::RemoveSuffix(size_t suffix_size) {
+constexpr void StringView::RemoveSuffix(size_t suffix_size) {
     size_ -= suffix_size;
 }
 
-inline const char* StringView::Data() const {
+constexpr const char* StringView::Data() const {
     return str_;
 }
 
-inline const StringView StringView::Substr(size_t pos, size_t count) const {
-    StringView substr(str_);
-    substr.RemovePrefix(pos);
-    size_t size = count + pos > substr.size_ ? substr.size_ - pos : count;
-    substr.size_ = size;
-    return substr;
+constexpr const StringView StringView::Substr(size_t pos, size_t count) const {
+    if (pos > size_) {
+        throw std::out_of_range("");
+    }
+    return StringView(str_ + pos, count < size_ - pos ? count : size_ - pos);
+}
+
+inline int StringView::Compare(StringView other) const {
+    const size_t size = size_ < other.size_ ? size_ : other.size_;
+    const int cmp = size == 0 ? 0 : memcmp(str_, other.str_, size);
+    if (cmp != 0) {
+        return cmp;
+    }
+    return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+}
+
+inline bool StringView::StartsWith(char c) const {
+    return size_ != 0 && str_[0] == c;
+}
+
+inline bool StringView::StartsWith(StringView prefix) const {
+    return prefix.size_ <= size_ && (prefix.size_ == 0 || memcmp(str_, prefix.str_, prefix.size_) == 0);
+}
+
+inline bool StringView::EndsWith(char c) const {
+    return size_ != 0 && str_[size_ - 1] == c;
+}
+
+inline bool StringView::EndsWith(StringView suffix) const {
+    return suffix.size_ <= size_ &&
+           (suffix.size_ == 0 || memcmp(str_ + size_ - suffix.size_, suffix.str_, suffix.size_) == 0);
+}
+
+inline bool StringView::EqualsIgnoreCase(StringView other) const {
+    return size_ == other.size_ && StringSearch::EqualIgnoreCase(str_, other.str_, size_);
+}
+
+inline size_t StringView::Find(char c, size_t pos) const {
+    if (pos >= size_) {
+        return kNpos;
+    }
+    const size_t found = StringSearch::FindChar(str_ + pos, size_ - pos, c);
+    return found == kNpos ? kNpos : pos + found;
+}
+
+inline size_t StringView::Find(StringView str, size_t pos) const {
+    if (pos > size_) {
+        return kNpos;
+    }
+    const size_t found = StringSearch::Find(str_ + pos, size_ - pos, str.str_, str.size_);
+    return found == kNpos ? kNpos : pos + found;
+}
+
+inline size_t StringView::RFind(char c, size_t pos) const {
+    if (size_ == 0) {
+        return kNpos;
+    }
+    const size_t size = pos < size_ ? pos + 1 : size_;
+    return StringSearch::RFindChar(str_, size, c);
+}
+
+inline size_t StringView::RFind(StringView str, size_t pos) const {
+    if (str.size_ > size_) {
+        return kNpos;
+    }
+    const size_t last = size_ - str.size_;
+    const size_t size = (pos < last ? pos : last) + str.size_;
+    return StringSearch::RFind(str_, size, str.str_, str.size_);
+}
+
+inline size_t StringView::FindFirstOf(StringView set, size_t pos) const {
+    if (pos >= size_) {
+        return kNpos;
+    }
+    const size_t found = StringSearch::FindFirstOf(str_ + pos, size_ - pos, set.str_, set.size_);
+    return found == kNpos ? kNpos : pos + found;
+}
+
+inline size_t StringView::FindFirstNotOf(StringView set, size_t pos) const {
+    if (pos >= size_) {
+        return kNpos;
+    }
+    const size_t found = StringSearch::FindFirstNotOf(str_ + pos, size_ - pos, set.str_, set.size_);
+    return found == kNpos ? kNpos : pos + found;
+}
+
+inline bool StringView::Contains(char c) const {
+    return Find(c) != kNpos;
+}
+
+inline bool StringView::Contains(StringView str) const {
+    return Find(str) != kNpos;
+}
+
+inline size_t StringView::Count(char c) const {
+    return StringSearch::CountChar(str_, size_, c);
+}
+
+inline bool operator==(StringView lhs, StringView rhs) {
+    return lhs.Size() == rhs.Size() && (lhs.Empty() || memcmp(lhs.Data(), rhs.Data(), lhs.Size()) == 0);
+}
+
+inline bool operator!=(StringView lhs, StringView rhs) {
+    return !(lhs == rhs);
+}
+
+inline bool operator<(StringView lhs, StringView rhs) {
+    return lhs.Compare(rhs) < 0;
+}
+
+inline bool operator<=(StringView lhs, StringView rhs) {
+    return lhs.Compare(rhs) <= 0;
+}
+
+inline bool operator>(StringView lhs, StringView rhs) {
+    return lhs.Compare(rhs) > 0;
+}
+
+inline bool operator>=(StringView lhs, StringView rhs) {
+    return lhs.Compare(rhs) >= 0;
 }
 
 #endif
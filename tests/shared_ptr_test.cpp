@@ -0,0 +1,184 @@
+// Biased reference counting across threads. Meant to run under
+// ThreadSanitizer (make run), which reports any counter update or object
+// destruction that is not ordered with the accesses before it.
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "shared_ptr.h"
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+			std::abort(); \
+		} \
+	} while (false)
+
+static std::atomic<int> live(0);
+static std::atomic<int> destroyed(0);
+
+struct Tracked {
+	int value_;
+
+	explicit Tracked(int value) : value_(value) {
+		live.fetch_add(1, std::memory_order_relaxed);
+	}
+	~Tracked() {
+		// Written by whichever thread destroys the object, so that TSan sees a
+		// race if destruction is not ordered after every reader.
+		value_ = -1;
+		live.fetch_sub(1, std::memory_order_relaxed);
+		destroyed.fetch_add(1, std::memory_order_relaxed);
+	}
+};
+
+// Workers copy and drop objects owned by this thread while the owner does the
+// same; the owner then drops its references and the workers hold the last.
+static void CrossThreadCopyAndDrop() {
+	const int kObjects = 64;
+	const int kThreads = 4;
+	const int kRounds = 50;
+	for (int round = 0; round < kRounds; ++round) {
+		std::vector<SharedPtr<Tracked>> objects;
+		for (int i = 0; i < kObjects; ++i) {
+			objects.push_back(SharedPtr<Tracked>(new Tracked(i)));
+		}
+		std::vector<std::vector<SharedPtr<Tracked>>> kept(kThreads);
+		std::atomic<bool> go(false);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < kThreads; ++t) {
+			threads.emplace_back([&, t] {
+				while (!go.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+				for (int i = 0; i < kObjects; ++i) {
+					SharedPtr<Tracked> copy(objects[i]);
+					SharedPtr<Tracked> again(copy);
+					CHECK(again->value_ == i);
+					if (i % kThreads == t) {
+						kept[t].push_back(again);
+					}
+				}
+			});
+		}
+		go.store(true, std::memory_order_release);
+		for (int i = 0; i < kObjects; ++i) {
+			SharedPtr<Tracked> copy(objects[i]);
+			CHECK(copy->value_ == i);
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		objects.clear();
+		CHECK(live.load() == kObjects);
+		for (int t = 0; t < kThreads; ++t) {
+			threads[t] = std::thread([&, t] {
+				kept[t].clear();
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		MergeBiasedCounters();
+		CHECK(live.load() == 0);
+	}
+}
+
+// Drops ptr, the last SharedPtr, while another thread locks a WeakPtr to it in
+// a loop. Every successful Lock must see a live object, and once ptr is gone
+// Lock must start failing.
+static void LockRacesRelease(SharedPtr<Tracked>& ptr, int value) {
+	WeakPtr<Tracked> weak(ptr);
+	std::atomic<bool> go(false);
+	std::thread locker([&] {
+		while (!go.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+		for (;;) {
+			SharedPtr<Tracked> locked = weak.Lock();
+			if (!locked) {
+				break;
+			}
+			CHECK(locked->value_ == value);
+			std::this_thread::yield();
+		}
+	});
+	go.store(true, std::memory_order_release);
+	std::this_thread::yield();
+	ptr.Reset();
+	locker.join();
+	CHECK(weak.Expired());
+	CHECK(!weak.Lock());
+}
+
+// The object is destroyed exactly once, both when the owner drops the last
+// reference (the biased count merges under a concurrent Lock) and when the
+// count is already fully atomic because the owner thread has exited.
+static void LockRacesLastRelease() {
+	const int kRounds = 500;
+	const int before = destroyed.load();
+	for (int round = 0; round < kRounds; ++round) {
+		SharedPtr<Tracked> owned(new Tracked(round));
+		LockRacesRelease(owned, round);
+		SharedPtr<Tracked> orphan;
+		std::thread creator([&orphan, round] {
+			orphan = SharedPtr<Tracked>(new Tracked(round));
+		});
+		creator.join();
+		LockRacesRelease(orphan, round);
+	}
+	CHECK(destroyed.load() - before == 2 * kRounds);
+	CHECK(live.load() == 0);
+}
+
+// A non-owner thread drops the only reference to an object whose count is
+// still biased to this thread. The object must survive until the owner merges
+// its queue, and then be destroyed on the owner thread, but WeakPtrs must
+// already see it as expired on every thread.
+static void DeferredDestruction() {
+	SharedPtr<Tracked> ptr(new Tracked(7));
+	WeakPtr<Tracked> weak(ptr);
+	std::thread dropper([moved = std::move(ptr)]() mutable {
+		moved.Reset();
+	});
+	dropper.join();
+	CHECK(live.load() == 1);
+	CHECK(weak.UseCount() == 0);
+	CHECK(weak.Expired());
+	CHECK(!weak.Lock());
+	std::thread locker([&weak] {
+		CHECK(weak.Expired());
+		CHECK(!weak.Lock());
+	});
+	locker.join();
+	CHECK(live.load() == 1);
+	MergeBiasedCounters();
+	CHECK(live.load() == 0);
+	CHECK(weak.Expired());
+}
+
+// The owner thread exits while another thread still holds a reference, so the
+// releasing thread merges the counter itself.
+static void OwnerExitsFirst() {
+	SharedPtr<Tracked> kept;
+	std::thread owner([&kept] {
+		SharedPtr<Tracked> ptr(new Tracked(3));
+		kept = ptr;
+	});
+	owner.join();
+	CHECK(kept.UseCount() == 1);
+	kept.Reset();
+	CHECK(live.load() == 0);
+}
+
+int main() {
+	CrossThreadCopyAndDrop();
+	LockRacesLastRelease();
+	DeferredDestruction();
+	OwnerExitsFirst();
+	std::puts("shared_ptr_test: ok");
+	return 0;
+}
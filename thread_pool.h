@@ -0,0 +1,629 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "circular_buffer.h"
+#include "function.h"
+#include "shared_ptr.h"
+
+// Chase-Lev work-stealing deque, after Le et al. (2013), with the fences
+// folded into the bottom_/top_ accesses.
+// The owner pushes and pops at the bottom; any other thread steals from the
+// top. Slots form a power-of-two ring indexed with a mask, like
+// CircularBuffer; when it fills up the owner copies it into one twice as
+// large. Old rings stay alive until the deque is destroyed, since a thief may
+// still be reading from one.
+template <class T>
+class WorkStealingDeque {
+	static_assert(std::is_trivially_copyable<T>::value, "WorkStealingDeque requires a trivially copyable type");
+
+	struct Ring {
+		int64_t capacity_;
+		int64_t mask_;
+		std::atomic<T>* slots_;
+
+		explicit Ring(int64_t capacity);
+		~Ring();
+
+		T Get(int64_t idx) const;
+		void Put(int64_t idx, T value);
+		Ring* Grow(int64_t top, int64_t bottom) const;
+	};
+
+	alignas(64) std::atomic<int64_t> top_;
+	alignas(64) std::atomic<int64_t> bottom_;
+	std::atomic<Ring*> ring_;
+	std::vector<Ring*> retired_;
+
+public:
+	explicit WorkStealingDeque(size_t capacity = 256);
+	WorkStealingDeque(const WorkStealingDeque& other) = delete;
+	WorkStealingDeque& operator=(const WorkStealingDeque& other) = delete;
+	~WorkStealingDeque();
+
+	void Push(T value);
+	bool Pop(T* value);
+	bool Steal(T* value);
+	size_t Size() const;
+	bool Empty() const;
+};
+
+class TaskGroup;
+class TaskHandle;
+
+// Work-stealing thread pool. Every worker owns a WorkStealingDeque: tasks
+// spawned on a worker go to the bottom of its own deque and are run LIFO,
+// which keeps fork-join recursion cache-friendly, while idle workers steal
+// the oldest (largest) tasks from the top of others. Tasks submitted from
+// outside the pool go through a locked injection queue. A worker with nothing
+// to do spins, then yields, then parks on a condition variable until new work
+// is published.
+//
+// Waiting on a TaskGroup or TaskHandle from a worker runs other tasks in the
+// meantime, so nested fork-join does not block workers; waiting from any other
+// thread blocks.
+class ThreadPool {
+	struct Completion {
+		std::atomic<size_t> pending_;
+		std::mutex mutex_;
+		std::condition_variable done_;
+		std::exception_ptr error_;
+
+		Completion();
+		void Add();
+		void Finish(std::exception_ptr error);
+		void Rethrow();
+	};
+
+	struct Task {
+		UniqueFunction<void()> fn_;
+		Completion* completion_;
+	};
+
+	struct alignas(64) Worker {
+		ThreadPool* pool_;
+		WorkStealingDeque<Task*> deque_;
+		uint64_t rng_;
+		std::thread thread_;
+	};
+
+	const static size_t kSpinRounds = 64;
+	const static size_t kYieldRounds = 128;
+
+	std::vector<Worker*> workers_;
+	std::mutex inject_mutex_;
+	CircularBuffer<Task*> inject_;
+	std::atomic<size_t> inject_size_;
+	std::mutex park_mutex_;
+	std::condition_variable park_cv_;
+	std::atomic<uint64_t> epoch_;
+	std::atomic<size_t> sleepers_;
+	std::atomic<bool> stop_;
+
+	static Worker*& Current();
+	static void CpuRelax();
+	static void Run(Task* task);
+
+	Worker* Self() const;
+	void Spawn(Task* task);
+	Task* TakeInjected();
+	Task* Steal(Worker* self);
+	Task* FindTask(Worker* self);
+	bool HasWork() const;
+	void Notify();
+	void Park();
+	void WorkerLoop(Worker* self);
+	void WaitFor(Completion* completion);
+
+	template <class F>
+	void ParallelForRange(TaskGroup& group, size_t begin, size_t end, size_t grain, const F& body);
+
+	friend class TaskGroup;
+	friend class TaskHandle;
+
+public:
+	explicit ThreadPool(size_t threads = 0);
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+	~ThreadPool();
+
+	// Runs fn on the pool; the handle waits for it and rethrows its exception.
+	template <class F>
+	TaskHandle Submit(F&& fn);
+
+	// Calls body(i) for every i in [begin, end). The range is split lazily: a
+	// worker hands off half of what is left only when its deque is empty,
+	// i.e. when its previous half has been stolen, and otherwise runs `grain`
+	// iterations at a time. A grain of 0 picks one from the range size.
+	template <class F>
+	void ParallelFor(size_t begin, size_t end, const F& body, size_t grain = 0);
+
+	size_t Size() const;
+};
+
+// Handle to one submitted task. Copies share the same task.
+class TaskHandle {
+	ThreadPool* pool_;
+	SharedPtr<ThreadPool::Completion> completion_;
+
+	TaskHandle(ThreadPool* pool, const SharedPtr<ThreadPool::Completion>& completion);
+
+	friend class ThreadPool;
+
+public:
+	TaskHandle();
+
+	bool Valid() const;
+	bool Done() const;
+	void Wait();
+};
+
+// Set of tasks that are waited for together; tasks may add more tasks to
+// their own group. The destructor waits but does not rethrow.
+class TaskGroup {
+	ThreadPool* pool_;
+	ThreadPool::Completion completion_;
+
+public:
+	explicit TaskGroup(ThreadPool& pool);
+	TaskGroup(const TaskGroup& other) = delete;
+	TaskGroup& operator=(const TaskGroup& other) = delete;
+	~TaskGroup();
+
+	template <class F>
+	void Run(F&& fn);
+	void Wait();
+};
+
+template <class T>
+WorkStealingDeque<T>::Ring::Ring(int64_t capacity) :
+capacity_(capacity), mask_(capacity - 1), slots_(new std::atomic<T>[capacity]) {
+}
+
+template <class T>
+WorkStealingDeque<T>::Ring::~Ring() {
+	delete[] slots_;
+}
+
+template <class T>
+T WorkStealingDeque<T>::Ring::Get(int64_t idx) const {
+	return slots_[idx & mask_].load(std::memory_order_relaxed);
+}
+
+template <class T>
+void WorkStealingDeque<T>::Ring::Put(int64_t idx, T value) {
+	slots_[idx & mask_].store(value, std::memory_order_relaxed);
+}
+
+template <class T>
+typename WorkStealingDeque<T>::Ring* WorkStealingDeque<T>::Ring::Grow(int64_t top, int64_t bottom) const {
+	Ring* ring = new Ring(capacity_ * 2);
+	for (int64_t i = top; i < bottom; ++i) {
+		ring->Put(i, Get(i));
+	}
+	return ring;
+}
+
+template <class T>
+WorkStealingDeque<T>::WorkStealingDeque(size_t capacity) : top_(0), bottom_(0) {
+	size_t cap = 1;
+	while (cap < capacity) {
+		cap *= 2;
+	}
+	ring_.store(new Ring(static_cast<int64_t>(cap)), std::memory_order_relaxed);
+}
+
+template <class T>
+WorkStealingDeque<T>::~WorkStealingDeque() {
+	delete ring_.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < retired_.size(); ++i) {
+		delete retired_[i];
+	}
+}
+
+template <class T>
+void WorkStealingDeque<T>::Push(T value) {
+	const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+	const int64_t top = top_.load(std::memory_order_acquire);
+	Ring* ring = ring_.load(std::memory_order_relaxed);
+	if (bottom - top > ring->mask_) {
+		Ring* grown = ring->Grow(top, bottom);
+		retired_.push_back(ring);
+		ring = grown;
+		ring_.store(ring, std::memory_order_release);
+	}
+	ring->Put(bottom, value);
+	bottom_.store(bottom + 1, std::memory_order_release);
+}
+
+template <class T>
+bool WorkStealingDeque<T>::Pop(T* value) {
+	const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+	Ring* ring = ring_.load(std::memory_order_relaxed);
+	bottom_.store(bottom, std::memory_order_seq_cst);
+	int64_t top = top_.load(std::memory_order_seq_cst);
+	if (top > bottom) {
+		bottom_.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+	*value = ring->Get(bottom);
+	if (top == bottom) {
+		const bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		bottom_.store(bottom + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+// Fails if the deque looks empty or another thread took the top item first.
+template <class T>
+bool WorkStealingDeque<T>::Steal(T* value) {
+	int64_t top = top_.load(std::memory_order_seq_cst);
+	const int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+	if (top >= bottom) {
+		return false;
+	}
+	Ring* ring = ring_.load(std::memory_order_acquire);
+	const T item = ring->Get(top);
+	if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return false;
+	}
+	*value = item;
+	return true;
+}
+
+template <class T>
+size_t WorkStealingDeque<T>::Size() const {
+	const int64_t bottom = bottom_.load(std::memory_order_seq_cst);
+	const int64_t top = top_.load(std::memory_order_seq_cst);
+	return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+}
+
+template <class T>
+bool WorkStealingDeque<T>::Empty() const {
+	return Size() == 0;
+}
+
+inline ThreadPool::Completion::Completion() : pending_(0) {
+}
+
+inline void ThreadPool::Completion::Add() {
+	pending_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The last decrement happens under the mutex so that a waiter, which takes
+// the mutex once it sees zero, cannot destroy the completion while the
+// notification is still in progress.
+inline void ThreadPool::Completion::Finish(std::exception_ptr error) {
+	if (error) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!error_) {
+			error_ = error;
+		}
+	}
+	size_t pending = pending_.load(std::memory_order_relaxed);
+	while (pending > 1) {
+		if (pending_.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			return;
+		}
+	}
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		done_.notify_all();
+	}
+}
+
+inline void ThreadPool::Completion::Rethrow() {
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::swap(error, error_);
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+inline ThreadPool::ThreadPool(size_t threads) : inject_size_(0), epoch_(0), sleepers_(0), stop_(false) {
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	if (threads == 0) {
+		threads = 1;
+	}
+	workers_.reserve(threads);
+	for (size_t i = 0; i < threads; ++i) {
+		Worker* worker = new Worker();
+		worker->pool_ = this;
+		worker->rng_ = 0x9E3779B97F4A7C15ull * (i + 1);
+		workers_.push_back(worker);
+	}
+	for (size_t i = 0; i < threads; ++i) {
+		workers_[i]->thread_ = std::thread(&ThreadPool::WorkerLoop, this, workers_[i]);
+	}
+}
+
+inline ThreadPool::~ThreadPool() {
+	stop_.store(true, std::memory_order_seq_cst);
+	{
+		std::lock_guard<std::mutex> lock(park_mutex_);
+		epoch_.fetch_add(1, std::memory_order_relaxed);
+	}
+	park_cv_.notify_all();
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		workers_[i]->thread_.join();
+	}
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		delete workers_[i];
+	}
+}
+
+inline ThreadPool::Worker*& ThreadPool::Current() {
+	static thread_local Worker* worker = nullptr;
+	return worker;
+}
+
+inline void ThreadPool::CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+inline void ThreadPool::Run(Task* task) {
+	std::exception_ptr error;
+	try {
+		task->fn_();
+	} catch (...) {
+		error = std::current_exception();
+	}
+	task->completion_->Finish(error);
+	delete task;
+}
+
+inline ThreadPool::Worker* ThreadPool::Self() const {
+	Worker* worker = Current();
+	return worker != nullptr && worker->pool_ == this ? worker : nullptr;
+}
+
+inline void ThreadPool::Spawn(Task* task) {
+	Worker* self = Self();
+	if (self != nullptr) {
+		self->deque_.Push(task);
+	} else {
+		std::lock_guard<std::mutex> lock(inject_mutex_);
+		inject_.PushBack(task);
+		inject_size_.fetch_add(1, std::memory_order_relaxed);
+	}
+	Notify();
+}
+
+inline ThreadPool::Task* ThreadPool::TakeInjected() {
+	if (inject_size_.load(std::memory_order_relaxed) == 0) {
+		return nullptr;
+	}
+	std::lock_guard<std::mutex> lock(inject_mutex_);
+	if (inject_.Empty()) {
+		return nullptr;
+	}
+	Task* task = inject_.Front();
+	inject_.PopFront();
+	inject_size_.fetch_sub(1, std::memory_order_relaxed);
+	return task;
+}
+
+inline ThreadPool::Task* ThreadPool::Steal(Worker* self) {
+	const size_t count = workers_.size();
+	self->rng_ ^= self->rng_ << 13;
+	self->rng_ ^= self->rng_ >> 7;
+	self->rng_ ^= self->rng_ << 17;
+	const size_t start = static_cast<size_t>(self->rng_ % count);
+	for (size_t i = 0; i < count; ++i) {
+		Worker* victim = workers_[(start + i) % count];
+		Task* task;
+		if (victim != self && victim->deque_.Steal(&task)) {
+			return task;
+		}
+	}
+	return nullptr;
+}
+
+inline ThreadPool::Task* ThreadPool::FindTask(Worker* self) {
+	Task* task;
+	if (self->deque_.Pop(&task)) {
+		return task;
+	}
+	task = TakeInjected();
+	if (task != nullptr) {
+		return task;
+	}
+	return Steal(self);
+}
+
+inline bool ThreadPool::HasWork() const {
+	if (inject_size_.load(std::memory_order_seq_cst) != 0) {
+		return true;
+	}
+	for (size_t i = 0; i < workers_.size(); ++i) {
+		if (!workers_[i]->deque_.Empty()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Pairs with Park: either the parking worker sees the new task in HasWork, or
+// this sees it in sleepers_ and bumps the epoch it waits on. Both sides do an
+// RMW on sleepers_, so one of them reads the other's write; unlike a fence,
+// ThreadSanitizer can follow the ordering.
+inline void ThreadPool::Notify() {
+	if (sleepers_.fetch_add(0, std::memory_order_seq_cst) == 0) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(park_mutex_);
+		epoch_.fetch_add(1, std::memory_order_relaxed);
+	}
+	park_cv_.notify_one();
+}
+
+inline void ThreadPool::Park() {
+	const uint64_t epoch = epoch_.load(std::memory_order_acquire);
+	sleepers_.fetch_add(1, std::memory_order_seq_cst);
+	if (!HasWork() && !stop_.load(std::memory_order_seq_cst)) {
+		std::unique_lock<std::mutex> lock(park_mutex_);
+		park_cv_.wait(lock, [&] {
+			return epoch_.load(std::memory_order_relaxed) != epoch || stop_.load(std::memory_order_relaxed);
+		});
+	}
+	sleepers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void ThreadPool::WorkerLoop(Worker* self) {
+	Current() = self;
+	size_t idle = 0;
+	while (true) {
+		Task* task = FindTask(self);
+		if (task != nullptr) {
+			Run(task);
+			idle = 0;
+			continue;
+		}
+		if (stop_.load(std::memory_order_acquire)) {
+			break;
+		}
+		++idle;
+		if (idle < kSpinRounds) {
+			CpuRelax();
+		} else if (idle < kSpinRounds + kYieldRounds) {
+			std::this_thread::yield();
+		} else {
+			Park();
+			idle = 0;
+		}
+	}
+	Current() = nullptr;
+}
+
+inline void ThreadPool::WaitFor(Completion* completion) {
+	Worker* self = Self();
+	if (self == nullptr) {
+		std::unique_lock<std::mutex> lock(completion->mutex_);
+		completion->done_.wait(lock, [&] { return completion->pending_.load(std::memory_order_acquire) == 0; });
+		return;
+	}
+	size_t idle = 0;
+	while (completion->pending_.load(std::memory_order_acquire) != 0) {
+		Task* task = FindTask(self);
+		if (task != nullptr) {
+			Run(task);
+			idle = 0;
+		} else if (++idle < kSpinRounds) {
+			CpuRelax();
+		} else {
+			std::unique_lock<std::mutex> lock(completion->mutex_);
+			completion->done_.wait_for(lock, std::chrono::microseconds(100), [&] {
+				return completion->pending_.load(std::memory_order_acquire) == 0;
+			});
+		}
+	}
+	std::lock_guard<std::mutex> lock(completion->mutex_);
+}
+
+template <class F>
+TaskHandle ThreadPool::Submit(F&& fn) {
+	SharedPtr<Completion> completion(new Completion());
+	Task* task = new Task{UniqueFunction<void()>([fn = std::forward<F>(fn), completion]() mutable { fn(); }), completion.Get()};
+	completion->Add();
+	Spawn(task);
+	return TaskHandle(this, completion);
+}
+
+template <class F>
+void ThreadPool::ParallelFor(size_t begin, size_t end, const F& body, size_t grain) {
+	if (begin >= end) {
+		return;
+	}
+	if (grain == 0) {
+		grain = (end - begin) / (workers_.size() * 16);
+		if (grain == 0) {
+			grain = 1;
+		}
+	}
+	TaskGroup group(*this);
+	group.Run([this, &group, begin, end, grain, &body] { ParallelForRange(group, begin, end, grain, body); });
+	group.Wait();
+}
+
+template <class F>
+void ThreadPool::ParallelForRange(TaskGroup& group, size_t begin, size_t end, size_t grain, const F& body) {
+	Worker* self = Self();
+	while (begin < end) {
+		if (end - begin > grain && self->deque_.Empty()) {
+			const size_t mid = begin + (end - begin) / 2;
+			group.Run([this, &group, mid, end, grain, &body] { ParallelForRange(group, mid, end, grain, body); });
+			end = mid;
+			continue;
+		}
+		const size_t stop = end - begin > grain ? begin + grain : end;
+		for (; begin < stop; ++begin) {
+			body(begin);
+		}
+	}
+}
+
+inline size_t ThreadPool::Size() const {
+	return workers_.size();
+}
+
+inline TaskHandle::TaskHandle() : pool_(nullptr) {
+}
+
+inline TaskHandle::TaskHandle(ThreadPool* pool, const SharedPtr<ThreadPool::Completion>& completion) :
+pool_(pool), completion_(completion) {
+}
+
+inline bool TaskHandle::Valid() const {
+	return pool_ != nullptr;
+}
+
+inline bool TaskHandle::Done() const {
+	return completion_->pending_.load(std::memory_order_acquire) == 0;
+}
+
+inline void TaskHandle::Wait() {
+	pool_->WaitFor(completion_.Get());
+	completion_->Rethrow();
+}
+
+inline TaskGroup::TaskGroup(ThreadPool& pool) : pool_(&pool) {
+}
+
+inline TaskGroup::~TaskGroup() {
+	pool_->WaitFor(&completion_);
+}
+
+template <class F>
+void TaskGroup::Run(F&& fn) {
+	ThreadPool::Task* task = new ThreadPool::Task{UniqueFunction<void()>(std::forward<F>(fn)), &completion_};
+	completion_.Add();
+	pool_->Spawn(task);
+}
+
+inline void TaskGroup::Wait() {
+	pool_->WaitFor(&completion_);
+	completion_.Rethrow();
+}
+
+#endif
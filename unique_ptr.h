@@ -1,15 +1,81 @@
 #ifndef UNIQUE_PTR_H
 #define UNIQUE_PTR_H
 
+#include <cstddef>
+#include <type_traits>
 #include <utility>
 
 template <class T>
-class UniquePtr {
+struct DefaultDelete {
+	DefaultDelete() = default;
+	template <class U, class = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+	DefaultDelete(const DefaultDelete<U>&) {
+	}
+	void operator()(T* ptr) const {
+		delete ptr;
+	}
+};
+
+template <class T>
+struct DefaultDelete<T[]> {
+	void operator()(T* ptr) const {
+		delete[] ptr;
+	}
+};
+
+// Holds the pointer together with the deleter. Empty non-final deleters are
+// inherited from so that they take no space.
+template <class T, class Deleter, bool = std::is_empty<Deleter>::value && !std::is_final<Deleter>::value>
+class PtrWithDeleter : private Deleter {
 	T* ptr_;
 
+public:
+	PtrWithDeleter(T* ptr, Deleter deleter) : Deleter(std::move(deleter)), ptr_(ptr) {
+	}
+	T*& Ptr() {
+		return ptr_;
+	}
+	T* Ptr() const {
+		return ptr_;
+	}
+	Deleter& GetDeleter() {
+		return *this;
+	}
+	const Deleter& GetDeleter() const {
+		return *this;
+	}
+};
+
+template <class T, class Deleter>
+class PtrWithDeleter<T, Deleter, false> {
+	T* ptr_;
+	Deleter deleter_;
+
+public:
+	PtrWithDeleter(T* ptr, Deleter deleter) : ptr_(ptr), deleter_(std::move(deleter)) {
+	}
+	T*& Ptr() {
+		return ptr_;
+	}
+	T* Ptr() const {
+		return ptr_;
+	}
+	Deleter& GetDeleter() {
+		return deleter_;
+	}
+	const Deleter& GetDeleter() const {
+		return deleter_;
+	}
+};
+
+template <class T, class Deleter = DefaultDelete<T>>
+class UniquePtr {
+	PtrWithDeleter<T, Deleter> ptr_;
+
 public:
 	UniquePtr();
 	UniquePtr(T* object);
+	UniquePtr(T* object, Deleter deleter);
 	UniquePtr(const UniquePtr& other) = delete;
 	UniquePtr(UniquePtr&& other) noexcept;
 	UniquePtr& operator=(const UniquePtr& other) = delete;
@@ -18,75 +84,236 @@ public:
 
 	T* Release();
 	void Reset(T* ptr = nullptr);
-	void Swap(UniquePtr<T>& other);
+	void Swap(UniquePtr& other);
 	T* Get() const;
+	Deleter& GetDeleter();
+	const Deleter& GetDeleter() const;
 	T& operator*() const;
 	T* operator->() const;
 	explicit operator bool() const;
 };
 
+template <class T, class Deleter>
+class UniquePtr<T[], Deleter> {
+	PtrWithDeleter<T, Deleter> ptr_;
+
+public:
+	UniquePtr();
+	UniquePtr(T* object);
+	UniquePtr(T* object, Deleter deleter);
+	UniquePtr(const UniquePtr& other) = delete;
+	UniquePtr(UniquePtr&& other) noexcept;
+	UniquePtr& operator=(const UniquePtr& other) = delete;
+	UniquePtr& operator=(UniquePtr&& other) noexcept;
+	~UniquePtr();
+
+	T* Release();
+	void Reset(T* ptr = nullptr);
+	void Swap(UniquePtr& other);
+	T* Get() const;
+	Deleter& GetDeleter();
+	const Deleter& GetDeleter() const;
+	T& operator[](size_t idx) const;
+	explicit operator bool() const;
+};
+
+template <class T, class... Args>
+typename std::enable_if<!std::is_array<T>::value, UniquePtr<T>>::type MakeUnique(Args&&... args);
 template <class T>
-UniquePtr<T>::UniquePtr(): ptr_(nullptr) {
+typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0, UniquePtr<T>>::type MakeUnique(size_t size);
+// Default-initializes instead of value-initializing, so trivial types are
+// left unwritten.
+template <class T>
+typename std::enable_if<!std::is_array<T>::value, UniquePtr<T>>::type MakeUniqueForOverwrite();
+template <class T>
+typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0, UniquePtr<T>>::type MakeUniqueForOverwrite(size_t size);
+
+template <class T, class Deleter>
+UniquePtr<T, Deleter>::UniquePtr(): ptr_(nullptr, Deleter()) {
 }
 
-template <class T>
-UniquePtr<T>::UniquePtr(T* object): ptr_(object) {
+template <class T, class Deleter>
+UniquePtr<T, Deleter>::UniquePtr(T* object): ptr_(object, Deleter()) {
 }
 
-template <class T>
-UniquePtr<T>::UniquePtr(UniquePtr&& other) noexcept: ptr_(other.ptr_) {
-	other.ptr_ = nullptr;
+template <class T, class Deleter>
+UniquePtr<T, Deleter>::UniquePtr(T* object, Deleter deleter): ptr_(object, std::move(deleter)) {
 }
 
-template <class T>
-UniquePtr<T>& UniquePtr<T>::operator=(UniquePtr&& other) noexcept {
-	ptr_ = other.ptr_;
-	other.ptr_ = nullptr;
+template <class T, class Deleter>
+UniquePtr<T, Deleter>::UniquePtr(UniquePtr&& other) noexcept: ptr_(other.ptr_.Ptr(), std::move(other.ptr_.GetDeleter())) {
+	other.ptr_.Ptr() = nullptr;
+}
+
+template <class T, class Deleter>
+UniquePtr<T, Deleter>& UniquePtr<T, Deleter>::operator=(UniquePtr&& other) noexcept {
+	if (this != &other) {
+		Reset(other.Release());
+		ptr_.GetDeleter() = std::move(other.ptr_.GetDeleter());
+	}
 	return *this;
 }
 
-template <class T>
-UniquePtr<T>::~UniquePtr() {
-	delete ptr_;
+template <class T, class Deleter>
+UniquePtr<T, Deleter>::~UniquePtr() {
+	if (ptr_.Ptr() != nullptr) {
+		ptr_.GetDeleter()(ptr_.Ptr());
+	}
 }
 
-template <class T>
-T* UniquePtr<T>::Release() {
-	T* ptr = ptr_;
-	ptr_ = nullptr;
+template <class T, class Deleter>
+T* UniquePtr<T, Deleter>::Release() {
+	T* ptr = ptr_.Ptr();
+	ptr_.Ptr() = nullptr;
 	return ptr;
 }
 
-template <class T>
-void UniquePtr<T>::Reset(T* ptr) {
-	delete ptr_;
-	ptr_ = ptr;
+template <class T, class Deleter>
+void UniquePtr<T, Deleter>::Reset(T* ptr) {
+	T* old = ptr_.Ptr();
+	ptr_.Ptr() = ptr;
+	if (old != nullptr) {
+		ptr_.GetDeleter()(old);
+	}
 }
 
-template <class T>
-T* UniquePtr<T>::Get() const {
-	return ptr_;
+template <class T, class Deleter>
+T* UniquePtr<T, Deleter>::Get() const {
+	return ptr_.Ptr();
 }
 
-template <class T>
-T& UniquePtr<T>::operator*() const {
-	return *ptr_;
+template <class T, class Deleter>
+Deleter& UniquePtr<T, Deleter>::GetDeleter() {
+	return ptr_.GetDeleter();
+}
+
+template <class T, class Deleter>
+const Deleter& UniquePtr<T, Deleter>::GetDeleter() const {
+	return ptr_.GetDeleter();
+}
+
+template <class T, class Deleter>
+T& UniquePtr<T, Deleter>::operator*() const {
+	return *ptr_.Ptr();
+}
+
+template <class T, class Deleter>
+T* UniquePtr<T, Deleter>::operator->() const {
+	return ptr_.Ptr();
+}
+
+template <class T, class Deleter>
+void UniquePtr<T, Deleter>::Swap(UniquePtr& other) {
+	std::swap(ptr_, other.ptr_);
+}
+
+template <class T, class Deleter>
+UniquePtr<T, Deleter>::operator bool() const {
+	return ptr_.Ptr() != nullptr;
+}
+
+
+template <class T, class Deleter>
+UniquePtr<T[], Deleter>::UniquePtr(): ptr_(nullptr, Deleter()) {
+}
+
+template <class T, class Deleter>
+UniquePtr<T[], Deleter>::UniquePtr(T* object): ptr_(object, Deleter()) {
+}
+
+template <class T, class Deleter>
+UniquePtr<T[], Deleter>::UniquePtr(T* object, Deleter deleter): ptr_(object, std::move(deleter)) {
+}
+
+template <class T, class Deleter>
+UniquePtr<T[], Deleter>::UniquePtr(UniquePtr&& other) noexcept: ptr_(other.ptr_.Ptr(), std::move(other.ptr_.GetDeleter())) {
+	other.ptr_.Ptr() = nullptr;
+}
+
+template <class T, class Deleter>
+UniquePtr<T[], Deleter>& UniquePtr<T[], Deleter>::operator=(UniquePtr&& other) noexcept {
+	if (this != &other) {
+		Reset(other.Release());
+		ptr_.GetDeleter() = std::move(other.ptr_.GetDeleter());
+	}
+	return *this;
+}
+
+template <class T, class Deleter>
+UniquePtr<T[], Deleter>::~UniquePtr() {
+	if (ptr_.Ptr() != nullptr) {
+		ptr_.GetDeleter()(ptr_.Ptr());
+	}
+}
+
+template <class T, class Deleter>
+T* UniquePtr<T[], Deleter>::Release() {
+	T* ptr = ptr_.Ptr();
+	ptr_.Ptr() = nullptr;
+	return ptr;
+}
+
+template <class T, class Deleter>
+void UniquePtr<T[], Deleter>::Reset(T* ptr) {
+	T* old = ptr_.Ptr();
+	ptr_.Ptr() = ptr;
+	if (old != nullptr) {
+		ptr_.GetDeleter()(old);
+	}
+}
+
+template <class T, class Deleter>
+T* UniquePtr<T[], Deleter>::Get() const {
+	return ptr_.Ptr();
+}
+
+template <class T, class Deleter>
+Deleter& UniquePtr<T[], Deleter>::GetDeleter() {
+	return ptr_.GetDeleter();
+}
+
+template <class T, class Deleter>
+const Deleter& UniquePtr<T[], Deleter>::GetDeleter() const {
+	return ptr_.GetDeleter();
+}
+
+template <class T, class Deleter>
+T& UniquePtr<T[], Deleter>::operator[](size_t idx) const {
+	return ptr_.Ptr()[idx];
+}
+
+template <class T, class Deleter>
+void UniquePtr<T[], Deleter>::Swap(UniquePtr& other) {
+	std::swap(ptr_, other.ptr_);
+}
+
+template <class T, class Deleter>
+UniquePtr<T[], Deleter>::operator bool() const {
+	return ptr_.Ptr() != nullptr;
+}
+
+
+template <class T, class... Args>
+typename std::enable_if<!std::is_array<T>::value, UniquePtr<T>>::type MakeUnique(Args&&... args) {
+	return UniquePtr<T>(new T(std::forward<Args>(args)...));
 }
 
 template <class T>
-T* UniquePtr<T>::operator->() const {
-	return ptr_;
+typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0, UniquePtr<T>>::type MakeUnique(size_t size) {
+	return UniquePtr<T>(new typename std::remove_extent<T>::type[size]());
 }
 
 template <class T>
-void UniquePtr<T>::Swap(UniquePtr<T>& other) {
-	std::swap(ptr_, other.ptr_);
+typename std::enable_if<!std::is_array<T>::value, UniquePtr<T>>::type MakeUniqueForOverwrite() {
+	return UniquePtr<T>(new T);
 }
 
 template <class T>
-UniquePtr<T>::operator bool() const {
-	return ptr_ != nullptr;
+typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0, UniquePtr<T>>::type MakeUniqueForOverwrite(size_t size) {
+	return UniquePtr<T>(new typename std::remove_extent<T>::type[size]);
 }
 
+static_assert(sizeof(UniquePtr<int>) == sizeof(int*), "UniquePtr with a stateless deleter must be one pointer");
+static_assert(sizeof(UniquePtr<int[]>) == sizeof(int*), "UniquePtr with a stateless deleter must be one pointer");
 
-#endif 
\ No newline at end of file
+#endif
@@ -0,0 +1,553 @@
+#ifndef VARIANT_H
+#define VARIANT_H
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "any.h"
+
+class BadVariantAccess : public std::exception {
+public:
+	const char* what() const noexcept override {
+		return "BadVariantAccess";
+	}
+};
+
+template<size_t I>
+struct InPlaceIndex {
+	explicit InPlaceIndex() = default;
+};
+
+template<class T, class... Ts>
+struct VariantIndexOf;
+
+template<class T, class... Ts>
+struct VariantIndexOf<T, T, Ts...> : std::integral_constant<size_t, 0> {
+};
+
+template<class T, class U, class... Ts>
+struct VariantIndexOf<T, U, Ts...> : std::integral_constant<size_t, 1 + VariantIndexOf<T, Ts...>::value> {
+};
+
+template<size_t I, class... Ts>
+struct VariantAlternative;
+
+template<class T, class... Ts>
+struct VariantAlternative<0, T, Ts...> {
+	typedef T type;
+};
+
+template<size_t I, class T, class... Ts>
+struct VariantAlternative<I, T, Ts...> : VariantAlternative<I - 1, Ts...> {
+};
+
+template<size_t... Values>
+struct VariantMax;
+
+template<size_t Value>
+struct VariantMax<Value> : std::integral_constant<size_t, Value> {
+};
+
+template<size_t Value, size_t... Values>
+struct VariantMax<Value, Values...>
+	: std::integral_constant<size_t, (Value > VariantMax<Values...>::value ? Value : VariantMax<Values...>::value)> {
+};
+
+// Raw storage and the index of the active alternative. The special members
+// of Variant are added by the layers below only when some alternative needs
+// them, so a Variant of trivially copyable types is trivially copyable.
+template<class... Ts>
+class VariantStorage {
+public:
+	typedef typename std::conditional<sizeof...(Ts) < 255, uint8_t, uint16_t>::type Index;
+	const static Index kNpos = static_cast<Index>(-1);
+
+protected:
+	alignas(Ts...) unsigned char storage_[VariantMax<sizeof(Ts)...>::value];
+	Index index_;
+
+	template<size_t I>
+	typename VariantAlternative<I, Ts...>::type* Ptr();
+	template<size_t I>
+	const typename VariantAlternative<I, Ts...>::type* Ptr() const;
+	template<size_t I, class... Args>
+	void Construct(Args&&... args);
+	template<size_t I>
+	void DestroyAt();
+	template<size_t I>
+	void CopyAt(const VariantStorage& other);
+	template<size_t I>
+	void MoveAt(VariantStorage& other);
+	template<size_t... Is>
+	void Destroy(std::index_sequence<Is...>);
+	template<size_t... Is>
+	void CopyFrom(const VariantStorage& other, std::index_sequence<Is...>);
+	template<size_t... Is>
+	void MoveFrom(VariantStorage& other, std::index_sequence<Is...>);
+	void Destroy();
+	void CopyFrom(const VariantStorage& other);
+	void MoveFrom(VariantStorage& other);
+
+	template<class... Us>
+	friend class Variant;
+};
+
+template<class... Ts>
+template<size_t I>
+typename VariantAlternative<I, Ts...>::type* VariantStorage<Ts...>::Ptr() {
+	return std::launder(reinterpret_cast<typename VariantAlternative<I, Ts...>::type*>(storage_));
+}
+
+template<class... Ts>
+template<size_t I>
+const typename VariantAlternative<I, Ts...>::type* VariantStorage<Ts...>::Ptr() const {
+	return std::launder(reinterpret_cast<const typename VariantAlternative<I, Ts...>::type*>(storage_));
+}
+
+template<class... Ts>
+template<size_t I, class... Args>
+void VariantStorage<Ts...>::Construct(Args&&... args) {
+	::new (static_cast<void*>(storage_)) typename VariantAlternative<I, Ts...>::type(std::forward<Args>(args)...);
+	index_ = static_cast<Index>(I);
+}
+
+template<class... Ts>
+template<size_t I>
+void VariantStorage<Ts...>::DestroyAt() {
+	typedef typename VariantAlternative<I, Ts...>::type T;
+	Ptr<I>()->~T();
+}
+
+template<class... Ts>
+template<size_t I>
+void VariantStorage<Ts...>::CopyAt(const VariantStorage& other) {
+	Construct<I>(*other.template Ptr<I>());
+}
+
+template<class... Ts>
+template<size_t I>
+void VariantStorage<Ts...>::MoveAt(VariantStorage& other) {
+	Construct<I>(std::move(*other.template Ptr<I>()));
+}
+
+// The tables are indexed by position, not by type, so that a type listed
+// twice keeps the index it was stored under.
+template<class... Ts>
+template<size_t... Is>
+void VariantStorage<Ts...>::Destroy(std::index_sequence<Is...>) {
+	typedef void (VariantStorage::*Fn)();
+	static constexpr Fn kTable[] = {&VariantStorage::template DestroyAt<Is>...};
+	if (index_ != kNpos) {
+		(this->*kTable[index_])();
+		index_ = kNpos;
+	}
+}
+
+template<class... Ts>
+template<size_t... Is>
+void VariantStorage<Ts...>::CopyFrom(const VariantStorage& other, std::index_sequence<Is...>) {
+	typedef void (VariantStorage::*Fn)(const VariantStorage&);
+	static constexpr Fn kTable[] = {&VariantStorage::template CopyAt<Is>...};
+	index_ = kNpos;
+	if (other.index_ != kNpos) {
+		(this->*kTable[other.index_])(other);
+	}
+}
+
+template<class... Ts>
+template<size_t... Is>
+void VariantStorage<Ts...>::MoveFrom(VariantStorage& other, std::index_sequence<Is...>) {
+	typedef void (VariantStorage::*Fn)(VariantStorage&);
+	static constexpr Fn kTable[] = {&VariantStorage::template MoveAt<Is>...};
+	index_ = kNpos;
+	if (other.index_ != kNpos) {
+		(this->*kTable[other.index_])(other);
+	}
+}
+
+template<class... Ts>
+void VariantStorage<Ts...>::Destroy() {
+	Destroy(std::index_sequence_for<Ts...>());
+}
+
+template<class... Ts>
+void VariantStorage<Ts...>::CopyFrom(const VariantStorage& other) {
+	CopyFrom(other, std::index_sequence_for<Ts...>());
+}
+
+template<class... Ts>
+void VariantStorage<Ts...>::MoveFrom(VariantStorage& other) {
+	MoveFrom(other, std::index_sequence_for<Ts...>());
+}
+
+template<bool Trivial, class... Ts>
+class VariantDestructor : public VariantStorage<Ts...> {
+};
+
+template<class... Ts>
+class VariantDestructor<false, Ts...> : public VariantStorage<Ts...> {
+public:
+	VariantDestructor() = default;
+	VariantDestructor(const VariantDestructor& other) = default;
+	VariantDestructor(VariantDestructor&& other) = default;
+	VariantDestructor& operator=(const VariantDestructor& other) = default;
+	VariantDestructor& operator=(VariantDestructor&& other) = default;
+	~VariantDestructor() {
+		this->Destroy();
+	}
+};
+
+template<class... Ts>
+using VariantDestructorFor = VariantDestructor<(std::is_trivially_destructible<Ts>::value && ...), Ts...>;
+
+template<bool Trivial, class... Ts>
+class VariantCopy : public VariantDestructorFor<Ts...> {
+};
+
+template<class... Ts>
+class VariantCopy<false, Ts...> : public VariantDestructorFor<Ts...> {
+public:
+	VariantCopy() = default;
+	VariantCopy(const VariantCopy& other) {
+		this->CopyFrom(other);
+	}
+	VariantCopy(VariantCopy&& other) = default;
+	VariantCopy& operator=(const VariantCopy& other) = default;
+	VariantCopy& operator=(VariantCopy&& other) = default;
+};
+
+template<class... Ts>
+using VariantCopyFor = VariantCopy<(std::is_trivially_copy_constructible<Ts>::value && ...), Ts...>;
+
+template<bool Trivial, class... Ts>
+class VariantMove : public VariantCopyFor<Ts...> {
+};
+
+template<class... Ts>
+class VariantMove<false, Ts...> : public VariantCopyFor<Ts...> {
+public:
+	VariantMove() = default;
+	VariantMove(const VariantMove& other) = default;
+	VariantMove(VariantMove&& other) noexcept((std::is_nothrow_move_constructible<Ts>::value && ...)) {
+		this->MoveFrom(other);
+	}
+	VariantMove& operator=(const VariantMove& other) = default;
+	VariantMove& operator=(VariantMove&& other) = default;
+};
+
+template<class... Ts>
+using VariantMoveFor = VariantMove<(std::is_trivially_move_constructible<Ts>::value && ...), Ts...>;
+
+template<bool Trivial, class... Ts>
+class VariantCopyAssign : public VariantMoveFor<Ts...> {
+};
+
+template<class... Ts>
+class VariantCopyAssign<false, Ts...> : public VariantMoveFor<Ts...> {
+public:
+	VariantCopyAssign() = default;
+	VariantCopyAssign(const VariantCopyAssign& other) = default;
+	VariantCopyAssign(VariantCopyAssign&& other) = default;
+	VariantCopyAssign& operator=(const VariantCopyAssign& other) {
+		if (this != &other) {
+			this->Destroy();
+			this->CopyFrom(other);
+		}
+		return *this;
+	}
+	VariantCopyAssign& operator=(VariantCopyAssign&& other) = default;
+};
+
+template<class... Ts>
+using VariantCopyAssignFor = VariantCopyAssign<((std::is_trivially_copy_assignable<Ts>::value &&
+												 std::is_trivially_copy_constructible<Ts>::value &&
+												 std::is_trivially_destructible<Ts>::value) && ...), Ts...>;
+
+template<bool Trivial, class... Ts>
+class VariantMoveAssign : public VariantCopyAssignFor<Ts...> {
+};
+
+template<class... Ts>
+class VariantMoveAssign<false, Ts...> : public VariantCopyAssignFor<Ts...> {
+public:
+	VariantMoveAssign() = default;
+	VariantMoveAssign(const VariantMoveAssign& other) = default;
+	VariantMoveAssign(VariantMoveAssign&& other) = default;
+	VariantMoveAssign& operator=(const VariantMoveAssign& other) = default;
+	VariantMoveAssign& operator=(VariantMoveAssign&& other) noexcept((std::is_nothrow_move_constructible<Ts>::value && ...)) {
+		if (this != &other) {
+			this->Destroy();
+			this->MoveFrom(other);
+		}
+		return *this;
+	}
+};
+
+template<class... Ts>
+using VariantMoveAssignFor = VariantMoveAssign<((std::is_trivially_move_assignable<Ts>::value &&
+												 std::is_trivially_move_constructible<Ts>::value &&
+												 std::is_trivially_destructible<Ts>::value) && ...), Ts...>;
+
+// Deletes copying when some alternative cannot be copied, so that
+// std::is_copy_constructible reports it instead of the copy failing to
+// instantiate.
+template<bool Copyable, class... Ts>
+class VariantCopyable : public VariantMoveAssignFor<Ts...> {
+};
+
+template<class... Ts>
+class VariantCopyable<false, Ts...> : public VariantMoveAssignFor<Ts...> {
+public:
+	VariantCopyable() = default;
+	VariantCopyable(const VariantCopyable& other) = delete;
+	VariantCopyable(VariantCopyable&& other) = default;
+	VariantCopyable& operator=(const VariantCopyable& other) = delete;
+	VariantCopyable& operator=(VariantCopyable&& other) = default;
+};
+
+template<class... Ts>
+using VariantCopyableFor = VariantCopyable<(std::is_copy_constructible<Ts>::value && ...), Ts...>;
+
+// Closed-set tagged union. Alternatives are selected by exact (decayed) type;
+// a Variant whose Emplace threw is left valueless.
+template<class... Ts>
+class Variant : public VariantCopyableFor<Ts...> {
+	template<class T>
+	using EnableIfAlternative = typename std::enable_if<(std::is_same<typename std::decay<T>::type, Ts>::value || ...)>::type;
+
+public:
+	const static size_t kSize = sizeof...(Ts);
+
+	Variant();
+	template<class T, class = EnableIfAlternative<T>>
+	Variant(T&& value);
+	template<class T, class... Args>
+	explicit Variant(InPlaceType<T>, Args&&... args);
+	template<size_t I, class... Args>
+	explicit Variant(InPlaceIndex<I>, Args&&... args);
+	template<class T, class = EnableIfAlternative<T>>
+	Variant& operator=(T&& value);
+
+	template<class T, class... Args>
+	T& Emplace(Args&&... args);
+	template<size_t I, class... Args>
+	typename VariantAlternative<I, Ts...>::type& Emplace(Args&&... args);
+	size_t Index() const;
+	bool ValuelessByException() const;
+	template<class T>
+	bool HoldsAlternative() const;
+	template<class T>
+	T* GetIf();
+	template<class T>
+	const T* GetIf() const;
+	template<size_t I>
+	typename VariantAlternative<I, Ts...>::type* GetIf();
+	template<size_t I>
+	const typename VariantAlternative<I, Ts...>::type* GetIf() const;
+};
+
+template<class... Ts>
+Variant<Ts...>::Variant() {
+	this->template Construct<0>();
+}
+
+template<class... Ts>
+template<class T, class>
+Variant<Ts...>::Variant(T&& value) {
+	this->template Construct<VariantIndexOf<typename std::decay<T>::type, Ts...>::value>(std::forward<T>(value));
+}
+
+template<class... Ts>
+template<class T, class... Args>
+Variant<Ts...>::Variant(InPlaceType<T>, Args&&... args) {
+	this->template Construct<VariantIndexOf<T, Ts...>::value>(std::forward<Args>(args)...);
+}
+
+template<class... Ts>
+template<size_t I, class... Args>
+Variant<Ts...>::Variant(InPlaceIndex<I>, Args&&... args) {
+	this->template Construct<I>(std::forward<Args>(args)...);
+}
+
+template<class... Ts>
+template<class T, class>
+Variant<Ts...>& Variant<Ts...>::operator=(T&& value) {
+	typedef typename std::decay<T>::type Value;
+	if (Value* current = GetIf<Value>()) {
+		*current = std::forward<T>(value);
+	} else {
+		Emplace<Value>(std::forward<T>(value));
+	}
+	return *this;
+}
+
+template<class... Ts>
+template<class T, class... Args>
+T& Variant<Ts...>::Emplace(Args&&... args) {
+	return Emplace<VariantIndexOf<T, Ts...>::value>(std::forward<Args>(args)...);
+}
+
+template<class... Ts>
+template<size_t I, class... Args>
+typename VariantAlternative<I, Ts...>::type& Variant<Ts...>::Emplace(Args&&... args) {
+	this->Destroy();
+	this->template Construct<I>(std::forward<Args>(args)...);
+	return *this->template Ptr<I>();
+}
+
+template<class... Ts>
+size_t Variant<Ts...>::Index() const {
+	return this->index_ == this->kNpos ? static_cast<size_t>(-1) : this->index_;
+}
+
+template<class... Ts>
+bool Variant<Ts...>::ValuelessByException() const {
+	return this->index_ == this->kNpos;
+}
+
+template<class... Ts>
+template<class T>
+bool Variant<Ts...>::HoldsAlternative() const {
+	return this->index_ == VariantIndexOf<T, Ts...>::value;
+}
+
+template<class... Ts>
+template<class T>
+T* Variant<Ts...>::GetIf() {
+	return GetIf<VariantIndexOf<T, Ts...>::value>();
+}
+
+template<class... Ts>
+template<class T>
+const T* Variant<Ts...>::GetIf() const {
+	return GetIf<VariantIndexOf<T, Ts...>::value>();
+}
+
+template<class... Ts>
+template<size_t I>
+typename VariantAlternative<I, Ts...>::type* Variant<Ts...>::GetIf() {
+	return this->index_ == I ? this->template Ptr<I>() : nullptr;
+}
+
+template<class... Ts>
+template<size_t I>
+const typename VariantAlternative<I, Ts...>::type* Variant<Ts...>::GetIf() const {
+	return this->index_ == I ? this->template Ptr<I>() : nullptr;
+}
+
+template<class T, class... Ts>
+T* GetIf(Variant<Ts...>* value) noexcept {
+	return value == nullptr ? nullptr : value->template GetIf<T>();
+}
+
+template<class T, class... Ts>
+const T* GetIf(const Variant<Ts...>* value) noexcept {
+	return value == nullptr ? nullptr : value->template GetIf<T>();
+}
+
+template<class T, class... Ts>
+T& Get(Variant<Ts...>& value) {
+	T* ptr = value.template GetIf<T>();
+	if (ptr == nullptr) {
+		throw BadVariantAccess();
+	}
+	return *ptr;
+}
+
+template<class T, class... Ts>
+const T& Get(const Variant<Ts...>& value) {
+	const T* ptr = value.template GetIf<T>();
+	if (ptr == nullptr) {
+		throw BadVariantAccess();
+	}
+	return *ptr;
+}
+
+template<class T>
+struct VariantTraits;
+
+template<class... Ts>
+struct VariantTraits<Variant<Ts...>> {
+	const static size_t kSize = sizeof...(Ts);
+	template<size_t I>
+	using Alternative = typename VariantAlternative<I, Ts...>::type;
+};
+
+template<class V>
+using VariantTraitsOf = VariantTraits<typename std::remove_cv<typename std::remove_reference<V>::type>::type>;
+
+template<size_t I, class V>
+decltype(auto) VariantGetUnchecked(V&& value) {
+	typedef typename VariantTraitsOf<V>::template Alternative<I> T;
+	typedef typename std::conditional<std::is_const<typename std::remove_reference<V>::type>::value, const T, T>::type Qualified;
+	Qualified* ptr = value.template GetIf<I>();
+	if constexpr (std::is_lvalue_reference<V>::value) {
+		return static_cast<Qualified&>(*ptr);
+	} else {
+		return static_cast<Qualified&&>(*ptr);
+	}
+}
+
+// Dispatches on the index of the first variant; the remaining variants are
+// dispatched the same way from inside the selected alternative. Up to
+// kBranchLimit alternatives are selected by comparing the index, which the
+// compiler turns into a switch with the calls inlined; larger variants go
+// through a table of function pointers built at compile time, an indirect
+// call that mispredicts when alternatives alternate.
+template<class F, class V, class... Vs>
+struct VariantVisitor {
+	const static size_t kBranchLimit = 8;
+
+	template<size_t I>
+	static decltype(auto) Invoke(F&& fn, V&& value, Vs&&... rest) {
+		if constexpr (sizeof...(Vs) == 0) {
+			return std::forward<F>(fn)(VariantGetUnchecked<I>(std::forward<V>(value)));
+		} else {
+			auto bound = [&fn, &value](auto&&... args) -> decltype(auto) {
+				return std::forward<F>(fn)(VariantGetUnchecked<I>(std::forward<V>(value)), std::forward<decltype(args)>(args)...);
+			};
+			return VariantVisitor<decltype(bound), Vs...>::Visit(std::move(bound), std::forward<Vs>(rest)...);
+		}
+	}
+
+	template<size_t I>
+	static decltype(auto) Branch(size_t index, F&& fn, V&& value, Vs&&... rest) {
+		if constexpr (I + 1 == VariantTraitsOf<V>::kSize) {
+			return Invoke<I>(std::forward<F>(fn), std::forward<V>(value), std::forward<Vs>(rest)...);
+		} else {
+			if (index == I) {
+				return Invoke<I>(std::forward<F>(fn), std::forward<V>(value), std::forward<Vs>(rest)...);
+			}
+			return Branch<I + 1>(index, std::forward<F>(fn), std::forward<V>(value), std::forward<Vs>(rest)...);
+		}
+	}
+
+	template<size_t... Is>
+	static decltype(auto) Dispatch(std::index_sequence<Is...>, F&& fn, V&& value, Vs&&... rest) {
+		if constexpr (sizeof...(Is) <= kBranchLimit) {
+			return Branch<0>(value.Index(), std::forward<F>(fn), std::forward<V>(value), std::forward<Vs>(rest)...);
+		} else {
+			typedef decltype(Invoke<0>(std::forward<F>(fn), std::forward<V>(value), std::forward<Vs>(rest)...)) R;
+			typedef R (*Fn)(F&&, V&&, Vs&&...);
+			static constexpr Fn kTable[] = {&Invoke<Is>...};
+			return kTable[value.Index()](std::forward<F>(fn), std::forward<V>(value), std::forward<Vs>(rest)...);
+		}
+	}
+
+	static decltype(auto) Visit(F&& fn, V&& value, Vs&&... rest) {
+		if (value.ValuelessByException()) {
+			throw BadVariantAccess();
+		}
+		return Dispatch(std::make_index_sequence<VariantTraitsOf<V>::kSize>(), std::forward<F>(fn),
+						std::forward<V>(value), std::forward<Vs>(rest)...);
+	}
+};
+
+template<class F, class V, class... Vs>
+decltype(auto) Visit(F&& fn, V&& value, Vs&&... rest) {
+	return VariantVisitor<F, V, Vs...>::Visit(std::forward<F>(fn), std::forward<V>(value), std::forward<Vs>(rest)...);
+}
+
+#endif // VARIANT_H
@@ -1,12 +1,15 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 #include <cstddef>
+#include "container_utils.h"
+#include "memory_resource.h"
 
 template<class T>
 class Vector {
 	size_t size_;
 	size_t capacity_;
 	T* buf_;
+	MemoryResource* resource_;
 	const static size_t kIncreaseFactor = 2;
 
 	void Reallocate(size_t cap);
@@ -15,6 +18,8 @@ class Vector {
 public:
 	Vector();
 	explicit Vector(size_t size);
+	explicit Vector(MemoryResource& resource);
+	Vector(size_t size, MemoryResource& resource);
 	Vector(size_t size, const T& value);
 	Vector(const Vector& other);
 	Vector& operator=(const Vector& other);
@@ -32,22 +37,17 @@ public:
 	void ShrinkToFit();
 	T& Front();
 	T& Back();
+	T* Data();
 	const T* Data() const;
 	const T Front() const;
 	const T Back() const;
 	void Swap(Vector& other);
+	MemoryResource* Resource() const;
 	const T operator[](size_t idx) const;
 	T& operator[](size_t idx);
 };
 
 
-template<class T>
-void Copy(const T* from, size_t size, T* to);
-template<class T>
-void Fill(T* buf, size_t size, const T& value);
-template<class T>
-void Swap(T& lhs, T& rhs);
-
 template<class T>
 bool operator<(const Vector<T>& lhs, const Vector<T>& rhs);
 template<class T>
@@ -64,10 +64,10 @@ bool operator!=(const Vector<T>& lhs, const Vector<T>& rhs);
 
 template <class T>
 void Vector<T>::Reallocate(size_t cap) {
-	capacity_ = cap;
-	T* new_buf = new T[capacity_];
+	T* new_buf = NewArray<T>(resource_, cap);
 	Copy(buf_, size_, new_buf);
-	delete[] buf_;
+	DeleteArray(resource_, buf_, capacity_);
+	capacity_ = cap;
 	buf_ = new_buf;
 }
 
@@ -83,12 +83,22 @@ size_t Vector<T>::CalculateCapacity(size_t cap) const {
 
 
 template <class T>
-Vector<T>::Vector() : size_(0), capacity_(0), buf_(nullptr) {}
+Vector<T>::Vector() : size_(0), capacity_(0), buf_(nullptr), resource_(nullptr) {}
+
+
+template <class T>
+Vector<T>::Vector(size_t size) : size_(size), capacity_(size), resource_(nullptr) {
+	buf_ = NewArray<T>(resource_, capacity_);
+}
+
+
+template <class T>
+Vector<T>::Vector(MemoryResource& resource) : size_(0), capacity_(0), buf_(nullptr), resource_(&resource) {}
 
 
 template <class T>
-Vector<T>::Vector(size_t size) : size_(size), capacity_(size) {
-	buf_ = new T[capacity_];
+Vector<T>::Vector(size_t size, MemoryResource& resource) : size_(size), capacity_(size), resource_(&resource) {
+	buf_ = NewArray<T>(resource_, capacity_);
 }
 
 
@@ -99,10 +109,10 @@ Vector<T>::Vector(size_t size, const T& value) : Vector(size) {
 
 
 template <class T>
-Vector<T>::Vector(const Vector& other) {
+Vector<T>::Vector(const Vector& other) : resource_(nullptr) {
 	size_ = other.size_;
 	capacity_ = other.capacity_;
-	buf_ = new T[capacity_];
+	buf_ = NewArray<T>(resource_, capacity_);
 	Copy(other.buf_, size_, buf_);
 }
 
@@ -122,7 +132,7 @@ Vector<T>& Vector<T>::operator=(const Vector& other) {
 
 template <class T>
 Vector<T>::~Vector() {
-	delete[] buf_;
+	DeleteArray(resource_, buf_, capacity_);
 }
 
 template <class T>
@@ -200,6 +210,11 @@ T& Vector<T>::Back() {
 	return buf_[size_ - 1];
 }
 
+template <class T>
+T* Vector<T>::Data() {
+	return buf_;
+}
+
 template <class T>
 const T* Vector<T>::Data() const {
 	return buf_;
@@ -223,6 +238,13 @@ void Vector<T>::Swap(Vector& other) {
 	::Swap(buf_, other.buf_);
 	::Swap(capacity_, other.capacity_);
 	::Swap(size_, other.size_);
+	::Swap(resource_, other.resource_);
+}
+
+
+template <class T>
+MemoryResource* Vector<T>::Resource() const {
+	return resource_;
 }
 
 
@@ -289,27 +311,4 @@ bool operator!=(const Vector<T>& lhs, const Vector<T>& rhs) {
 	return !(rhs == lhs);
 }
 
-
-template<class T>
-void Copy(const T* from, size_t size, T* to) {
-	for (size_t i = 0; i < size; ++i) {
-		to[i] = *from;
-		++from;
-	}
-}
-
-template<class T>
-void Fill(T* buf, size_t size, const T& value) {
-	for (size_t i = 0; i < size; ++i) {
-		buf[i] = value;
-	}
-}
-
-template <class T>
-void Swap(T& lhs, T& rhs) {
-	T temp = lhs;
-	lhs = rhs;
-	rhs = temp;
-}
-
 #endif